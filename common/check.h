@@ -0,0 +1,56 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Minimal checks for the test programs run by test.sh.
+ * A failed check is printed with its line and counted, the program goes on and exits with 1 at the end.
+ */
+
+#ifndef SULPRE_COMMON_CHECK_H
+#define SULPRE_COMMON_CHECK_H
+
+#include <iostream>
+
+namespace check {
+
+/**
+ * Number of failed checks so far.
+ */
+inline int& failures() {
+    static int count = 0;
+    return count;
+}
+
+inline bool verify(bool condition, const char* expression, const char* file, int line) {
+    if (!condition) {
+        ++failures();
+        std::cerr << file << ":" << line << ": check failed: " << expression << std::endl;
+    }
+
+    return condition;
+}
+
+/**
+ * Prints the outcome of the test program.
+ * @return Exit code of the program.
+ */
+inline int report(const char* name) {
+    if (failures()) {
+        std::cerr << name << ": " << failures() << " checks failed" << std::endl;
+        return 1;
+    }
+
+    std::cout << name << ": OK" << std::endl;
+    return 0;
+}
+
+} // namespace check
+
+/**
+ * Checks the condition, evaluates to it, so a test can skip what depends on it.
+ */
+#define CHECK(condition) check::verify(bool(condition), #condition, __FILE__, __LINE__)
+
+#endif
@@ -0,0 +1,91 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Command line application that compares how long it takes to load images
+ * with imread(), with the mapped input of imgio, from raw frames and from raw containers.
+ */
+
+#include "imgio.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <unistd.h>
+
+using namespace cv;
+using namespace std;
+
+void showHelp(const char *appName) {
+    cerr << "Compares decode time of imread(), mapped imdecode(), raw frames and raw containers.\n" <<
+        "Usage: " << appName << " [-n ITERATIONS] filename...\n" <<
+        "Using OpenCV version " << CV_VERSION << "\n";
+}
+
+/**
+ * @return Milliseconds per load.
+ */
+template<typename Load>
+double measure(Load load, int iterations) {
+    int64 start = getTickCount();
+    for (int i = 0; i < iterations; ++i) {
+        load();
+    }
+
+    return (getTickCount() - start) * 1000. / getTickFrequency() / iterations;
+}
+
+int main(int argc, const char** argv) {
+    int iterations = 10;
+    int first = 1;
+    if (argc > 2 && string(argv[1]) == "-n") {
+        iterations = atoi(argv[2]);
+        first = 3;
+    }
+    if (first >= argc || iterations <= 0) {
+        showHelp(argv[0]);
+        return 1;
+    }
+
+    // Converted copies go to a private directory, never next to the input.
+    const char* tmp = getenv("TMPDIR");
+    string dir = string(tmp && *tmp ? tmp : "/tmp") + "/imgbench.XXXXXX";
+    if (!mkdtemp(&dir[0])) {
+        cerr << "Couldn't create a directory " << dir << endl;
+        return 1;
+    }
+    string raw = dir + "/image.raw";
+    string container = dir + "/image.sprc";
+
+    cout << "file\timread ms\tmapped ms\traw ms\tcontainer ms" << endl;
+    for (int i = first; i < argc; ++i) {
+        string path = argv[i];
+        Mat image = imread(path, CV_LOAD_IMAGE_COLOR);
+        if (image.empty()) {
+            cerr << "Couldn't load image " << path << endl;
+            continue;
+        }
+
+        if (!imgio::saveRaw(raw, image) || !imgio::saveContainer(container, image)) {
+            cerr << "Couldn't write " << raw << endl;
+            unlink(raw.c_str());
+            unlink(container.c_str());
+            continue;
+        }
+
+        double imreadMs = measure([&] { imread(path, CV_LOAD_IMAGE_COLOR); }, iterations);
+        double mappedMs = measure([&] { imgio::load(path); }, iterations);
+        double rawMs = measure([&] { imgio::load(raw); }, iterations);
+        double containerMs = measure([&] { imgio::Image img; imgio::open(container, img); }, iterations);
+        unlink(raw.c_str());
+        unlink(container.c_str());
+
+        cout << path << "\t" << imreadMs << "\t" << mappedMs << "\t" << rawMs << "\t" << containerMs << endl;
+    }
+
+    rmdir(dir.c_str());
+
+    return 0;
+}
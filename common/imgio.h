@@ -0,0 +1,568 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Image input shared by fd, shapes and tpl.
+ * Files are mapped into memory and the mapping is passed to the decoder directly,
+ * so the encoded bytes are never copied into a temporary buffer.
+ * Raw frames (a small header followed by pixels) are taken as is without decoding.
+ * Raw containers (aligned rows, optional pyramid levels) are not even copied:
+ * pixels are used right from the mapping.
+ */
+
+#ifndef SULPRE_IMGIO_H
+#define SULPRE_IMGIO_H
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/highgui/highgui.hpp"
+
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace imgio {
+
+/**
+ * Read-only memory mapping of a whole file.
+ */
+class MappedFile {
+public:
+
+    MappedFile() : mData(0), mSize(0) {}
+
+    ~MappedFile() {
+        close();
+    }
+
+    /**
+     * Maps the file by path.
+     * The mapping is private and writable, changes are never written back to the file.
+     * @return false If could not open or the file is empty.
+     */
+    bool open(const std::string& path) {
+        close();
+        int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            void* data = mmap(0, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+            if (data != MAP_FAILED) {
+                mData = static_cast<unsigned char*>(data);
+                mSize = st.st_size;
+            }
+        }
+        ::close(fd);
+
+        return mData != 0;
+    }
+
+    void close() {
+        if (mData) {
+            munmap(mData, mSize);
+            mData = 0;
+            mSize = 0;
+        }
+    }
+
+    unsigned char* data() const {
+        return mData;
+    }
+
+    size_t size() const {
+        return mSize;
+    }
+
+private:
+
+    MappedFile(const MappedFile&);
+    MappedFile& operator=(const MappedFile&);
+
+    unsigned char* mData;
+    size_t mSize;
+};
+
+/**
+ * @return true If raw images may hold pixels of the type: 8-bit grayscale or BGR.
+ * Other types are rejected, callers read pixels as uchar or Vec3b.
+ */
+inline bool isRawType(uint32_t type) {
+    return type == CV_8UC1 || type == CV_8UC3;
+}
+
+/**
+ * Header of a raw frame. Followed by rows * cols * elemSize bytes of pixels without padding.
+ */
+struct RawHeader {
+    char magic[4];
+    uint32_t rows;
+    uint32_t cols;
+
+    /**
+     * OpenCV type of pixels, CV_8UC1 or CV_8UC3 for BGR.
+     */
+    uint32_t type;
+};
+
+const char RAW_MAGIC[4] = {'S', 'P', 'R', 'F'};
+
+/**
+ * Checks if the buffer contains a complete raw frame of a supported type
+ * whose dimensions fit into cv::Mat.
+ */
+inline bool isRaw(const unsigned char* data, size_t size) {
+    if (size < sizeof(RawHeader) || memcmp(data, RAW_MAGIC, sizeof(RAW_MAGIC)) != 0) {
+        return false;
+    }
+
+    RawHeader h;
+    memcpy(&h, data, sizeof(h));
+    if (!isRawType(h.type) || h.rows == 0 || h.cols == 0 || h.rows > INT_MAX || h.cols > INT_MAX) {
+        return false;
+    }
+
+    // Divides instead of multiplying, the product of header fields may overflow.
+    size_t row = size_t(h.cols) * CV_ELEM_SIZE(h.type);
+
+    return (size - sizeof(RawHeader)) / row >= h.rows;
+}
+
+/**
+ * Layout of one image in a raw container.
+ */
+struct LevelHeader {
+    uint32_t rows;
+    uint32_t cols;
+
+    /**
+     * OpenCV type of pixels, CV_8UC1 or CV_8UC3 for BGR.
+     */
+    uint32_t type;
+    uint32_t reserved;
+
+    /**
+     * Offset of the first row from the beginning of the file, multiple of CONTAINER_ALIGN.
+     */
+    uint64_t offset;
+
+    /**
+     * Bytes between rows, multiple of CONTAINER_ALIGN.
+     */
+    uint64_t step;
+};
+
+const int CONTAINER_MAX_LEVELS = 8;
+const size_t CONTAINER_ALIGN = 64;
+const char CONTAINER_MAGIC[4] = {'S', 'P', 'R', 'C'};
+const uint32_t CONTAINER_VERSION = 1;
+
+/**
+ * Header of a raw container.
+ * Level 0 is the image itself, each next level is half the size of the previous one as made by pyrDown().
+ *
+ * Both raw formats are kept on purpose. A frame (SPRF) is what a producer can write in one go from any
+ * cv::Mat, e.g. per camera frame, but its rows are packed, so pixels are copied out of the mapping.
+ * A container (SPRC) needs aligned rows and a full header written ahead, in return its pixels
+ * and pyramid levels are used right from the mapping. Both share the pixel types of isRawType().
+ */
+struct ContainerHeader {
+    char magic[4];
+    uint32_t version;
+    uint32_t levels;
+    uint32_t reserved;
+    LevelHeader level[CONTAINER_MAX_LEVELS];
+};
+
+/**
+ * Checks if the buffer contains a complete raw container of a supported type
+ * whose levels fit into cv::Mat.
+ */
+inline bool isContainer(const unsigned char* data, size_t size) {
+    if (size < sizeof(ContainerHeader) || memcmp(data, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC)) != 0) {
+        return false;
+    }
+
+    ContainerHeader h;
+    memcpy(&h, data, sizeof(h));
+    if (h.version != CONTAINER_VERSION || h.levels < 1 || h.levels > CONTAINER_MAX_LEVELS) {
+        return false;
+    }
+    for (uint32_t i = 0; i < h.levels; ++i) {
+        const LevelHeader& l = h.level[i];
+        if (!isRawType(l.type) || l.rows == 0 || l.cols == 0 || l.rows > INT_MAX || l.cols > INT_MAX ||
+            l.step < l.cols * uint64_t(CV_ELEM_SIZE(l.type)) || l.offset % CONTAINER_ALIGN != 0 || l.offset > size) {
+            return false;
+        }
+
+        // Divides instead of multiplying, the product of header fields may overflow.
+        if (l.step > (size - l.offset) / l.rows) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * Converts decoded pixels to what imread() would return for \a flags.
+ * Sources are 8-bit grayscale or BGR.
+ */
+inline void convert(const cv::Mat& src, cv::Mat& dst, int flags) {
+    if (flags == CV_LOAD_IMAGE_COLOR && src.channels() == 1) {
+        cv::cvtColor(src, dst, CV_GRAY2BGR);
+    } else if (flags == CV_LOAD_IMAGE_GRAYSCALE && src.channels() == 3) {
+        cv::cvtColor(src, dst, CV_BGR2GRAY);
+    } else {
+        src.copyTo(dst);
+    }
+}
+
+/**
+ * Decodes an image from memory: either a raw frame or any format OpenCV knows.
+ * @param Flags like for imread()
+ * @return Empty image if could not decode.
+ */
+inline cv::Mat decode(const unsigned char* data, size_t size, int flags = CV_LOAD_IMAGE_COLOR) {
+    cv::Mat image;
+    if (isContainer(data, size)) {
+        ContainerHeader h;
+        memcpy(&h, data, sizeof(h));
+        const LevelHeader& l = h.level[0];
+        cv::Mat pixels(l.rows, l.cols, l.type, const_cast<unsigned char*>(data) + l.offset, l.step);
+        convert(pixels, image, flags);
+    } else if (isRaw(data, size)) {
+        RawHeader h;
+        memcpy(&h, data, sizeof(h));
+        cv::Mat pixels(h.rows, h.cols, h.type, const_cast<unsigned char*>(data) + sizeof(RawHeader));
+        convert(pixels, image, flags);
+    } else {
+        // Wraps the buffer without copying.
+        cv::Mat buf(1, int(size), CV_8U, const_cast<unsigned char*>(data));
+        image = cv::imdecode(buf, flags);
+    }
+
+    return image;
+}
+
+/**
+ * Reads dimensions from the header of a JPEG or PNG without decoding it.
+ * @return false If the format is unknown or the header is broken.
+ */
+inline bool probe(const unsigned char* data, size_t size, cv::Size& dims) {
+    static const unsigned char PNG[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    if (size >= 24 && memcmp(data, PNG, sizeof(PNG)) == 0 && memcmp(data + 12, "IHDR", 4) == 0) {
+        dims.width = (data[16] << 24) | (data[17] << 16) | (data[18] << 8) | data[19];
+        dims.height = (data[20] << 24) | (data[21] << 16) | (data[22] << 8) | data[23];
+        return dims.width > 0 && dims.height > 0;
+    }
+
+    if (size < 4 || data[0] != 0xFF || data[1] != 0xD8) {
+        return false;
+    }
+
+    // Walks JPEG segments up to the start of frame.
+    size_t pos = 2;
+    while (pos + 4 <= size) {
+        if (data[pos] != 0xFF) {
+            return false;
+        }
+        unsigned char marker = data[pos + 1];
+        if (marker == 0xFF) {
+            ++pos;
+            continue;
+        }
+        size_t length = (data[pos + 2] << 8) | data[pos + 3];
+        bool sof = marker >= 0xC0 && marker <= 0xCF && marker != 0xC4 && marker != 0xC8 && marker != 0xCC;
+        if (sof) {
+            if (pos + 9 > size) {
+                return false;
+            }
+            dims.height = (data[pos + 5] << 8) | data[pos + 6];
+            dims.width = (data[pos + 7] << 8) | data[pos + 8];
+            return dims.width > 0 && dims.height > 0;
+        }
+        if (marker == 0xD9 || marker == 0xDA) {
+            return false;
+        }
+        pos += 2 + length;
+    }
+
+    return false;
+}
+
+/**
+ * @return The largest reduction a decoder can do for free, 1, 2, 4 or 8, that is not bigger than \a factor.
+ */
+inline int reduction(double factor) {
+    int result = 1;
+    while (result < 8 && result * 2 <= factor) {
+        result *= 2;
+    }
+
+    return result;
+}
+
+/**
+ * Decodes a grayscale image reduced by \a reduction, that is 1, 2, 4 or 8.
+ * JPEG decoders of OpenCV 3.2+ scale in the DCT domain so the full image is never produced,
+ * older ones decode the full image and shrink it.
+ * @return Empty image if could not decode.
+ */
+inline cv::Mat decodeReduced(const unsigned char* data, size_t size, int reduction) {
+#if CV_MAJOR_VERSION > 3 || (CV_MAJOR_VERSION == 3 && CV_MINOR_VERSION >= 2)
+    if (!isContainer(data, size) && !isRaw(data, size)) {
+        cv::Mat buf(1, int(size), CV_8U, const_cast<unsigned char*>(data));
+        int flags = reduction == 8 ? cv::IMREAD_REDUCED_GRAYSCALE_8 :
+            reduction == 4 ? cv::IMREAD_REDUCED_GRAYSCALE_4 :
+            reduction == 2 ? cv::IMREAD_REDUCED_GRAYSCALE_2 : cv::IMREAD_GRAYSCALE;
+        return cv::imdecode(buf, flags);
+    }
+#endif
+
+    cv::Mat image = decode(data, size, CV_LOAD_IMAGE_GRAYSCALE);
+    if (reduction > 1 && !image.empty()) {
+        cv::Mat reduced;
+        cv::Size sz((image.cols + reduction - 1) / reduction, (image.rows + reduction - 1) / reduction);
+        cv::resize(image, reduced, sz, 0, 0, cv::INTER_AREA);
+        image = reduced;
+    }
+
+    return image;
+}
+
+/**
+ * Pixel memory that grows to the largest image and is reused for all smaller ones.
+ */
+class PixelBuffer {
+public:
+
+    PixelBuffer() : mCapacity(0), mGrowths(0) {}
+
+    /**
+     * @return Image of the size and type over the buffer, the buffer grows if it is too small.
+     */
+    cv::Mat get(cv::Size size, int type) {
+        size_t bytes = size_t(size.width) * size.height * CV_ELEM_SIZE(type);
+        if (bytes > mCapacity) {
+            mBuffer.create(1, int(bytes), CV_8U);
+            mCapacity = bytes;
+            ++mGrowths;
+        }
+
+        return cv::Mat(size.height, size.width, type, mBuffer.data);
+    }
+
+    /**
+     * How many times the buffer had to grow.
+     */
+    size_t growths() const {
+        return mGrowths;
+    }
+
+private:
+
+    cv::Mat mBuffer;
+    size_t mCapacity;
+    size_t mGrowths;
+};
+
+/**
+ * Decodes a JPEG or PNG of known dimensions into the buffer, so no pixel memory is allocated
+ * once the buffer is large enough. The result is only valid until the buffer is used again.
+ * A decoder may still put pixels elsewhere, e.g. if EXIF orientation rotates the image.
+ * @param Dimensions from probe()
+ * @param CV_LOAD_IMAGE_COLOR or CV_LOAD_IMAGE_GRAYSCALE
+ * @param Decoded image, empty if could not decode
+ * @return false If could not decode.
+ */
+inline bool decodeInto(const unsigned char* data, size_t size, cv::Size dims, int flags, PixelBuffer& buffer,
+    cv::Mat& image) {
+    cv::Mat buf(1, int(size), CV_8U, const_cast<unsigned char*>(data));
+#if CV_MAJOR_VERSION >= 4
+    // A failed decode leaves the destination as it was, with pixels of an earlier image,
+    // so success is told by the returned image only.
+    int type = flags == CV_LOAD_IMAGE_GRAYSCALE ? CV_8UC1 : CV_8UC3;
+    cv::Mat target = buffer.get(dims, type);
+    image = cv::imdecode(buf, flags, &target);
+#else
+    // Older versions return the destination even if decoding failed, so failures can't be told apart
+    // from earlier pixels in the buffer. The image is decoded into its own memory.
+    image = cv::imdecode(buf, flags);
+#endif
+
+    return !image.empty();
+}
+
+/**
+ * Replacement for imread() that maps the file instead of reading it.
+ * @return Empty image if could not load.
+ */
+inline cv::Mat load(const std::string& path, int flags = CV_LOAD_IMAGE_COLOR) {
+    MappedFile file;
+    if (!file.open(path)) {
+        return cv::Mat();
+    }
+
+    return decode(file.data(), file.size(), flags);
+}
+
+/**
+ * Loaded image that may point right into a mapped raw container.
+ * Copies share the mapping, it stays alive while any copy does.
+ */
+struct Image {
+    /**
+     * The image itself.
+     */
+    cv::Mat pixels;
+
+    /**
+     * Smaller versions of the image from the container, each half the size of the previous.
+     */
+    std::vector<cv::Mat> levels;
+
+    /**
+     * True if pixels are used from the mapping without decoding or copying.
+     */
+    bool mapped;
+
+    std::shared_ptr<MappedFile> file;
+
+    Image() : mapped(false) {}
+};
+
+/**
+ * Loads an image by path. Raw containers of matching type are wrapped without copying,
+ * everything else is decoded like load() does.
+ * @param Flags like for imread()
+ * @return false If could not load.
+ */
+inline bool open(const std::string& path, Image& image, int flags = CV_LOAD_IMAGE_COLOR) {
+    image = Image();
+    std::shared_ptr<MappedFile> file = std::make_shared<MappedFile>();
+    if (!file->open(path)) {
+        return false;
+    }
+
+    if (isContainer(file->data(), file->size())) {
+        ContainerHeader h;
+        memcpy(&h, file->data(), sizeof(h));
+        int cn = CV_MAT_CN(h.level[0].type);
+        bool matches = flags == CV_LOAD_IMAGE_UNCHANGED ||
+            (flags == CV_LOAD_IMAGE_COLOR && cn == 3) ||
+            (flags == CV_LOAD_IMAGE_GRAYSCALE && cn == 1);
+        for (uint32_t i = 0; i < h.levels; ++i) {
+            const LevelHeader& l = h.level[i];
+            cv::Mat level(l.rows, l.cols, l.type, file->data() + l.offset, l.step);
+            if (!matches) {
+                cv::Mat converted;
+                convert(level, converted, flags);
+                level = converted;
+            }
+            if (i == 0) {
+                image.pixels = level;
+            } else {
+                image.levels.push_back(level);
+            }
+        }
+        image.mapped = matches;
+        if (matches) {
+            image.file = file;
+        }
+    } else {
+        image.pixels = decode(file->data(), file->size(), flags);
+    }
+
+    return !image.pixels.empty();
+}
+
+/**
+ * Stores the image as a raw container with \a levels - 1 additional pyramid levels.
+ * @return false If the type is not supported or could not write.
+ */
+inline bool saveContainer(const std::string& path, const cv::Mat& image, int levels = 1) {
+    if (image.empty() || !isRawType(image.type()) || levels < 1 || levels > CONTAINER_MAX_LEVELS) {
+        return false;
+    }
+
+    std::vector<cv::Mat> pyramid(1, image);
+    for (int i = 1; i < levels && pyramid.back().rows > 1 && pyramid.back().cols > 1; ++i) {
+        cv::Mat down;
+        cv::pyrDown(pyramid.back(), down);
+        pyramid.push_back(down);
+    }
+
+    ContainerHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, CONTAINER_MAGIC, sizeof(CONTAINER_MAGIC));
+    h.version = CONTAINER_VERSION;
+    h.levels = pyramid.size();
+    uint64_t offset = (sizeof(h) + CONTAINER_ALIGN - 1) / CONTAINER_ALIGN * CONTAINER_ALIGN;
+    for (size_t i = 0; i < pyramid.size(); ++i) {
+        LevelHeader& l = h.level[i];
+        l.rows = pyramid[i].rows;
+        l.cols = pyramid[i].cols;
+        l.type = pyramid[i].type();
+        l.step = (pyramid[i].cols * pyramid[i].elemSize() + CONTAINER_ALIGN - 1) / CONTAINER_ALIGN * CONTAINER_ALIGN;
+        l.offset = offset;
+        offset += l.step * l.rows;
+    }
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    std::vector<char> padding(CONTAINER_ALIGN, 0);
+    uint64_t written = sizeof(h);
+    for (size_t i = 0; i < pyramid.size(); ++i) {
+        const LevelHeader& l = h.level[i];
+        out.write(&padding[0], l.offset - written);
+        written = l.offset;
+        size_t row = pyramid[i].cols * pyramid[i].elemSize();
+        for (int y = 0; y < pyramid[i].rows; ++y) {
+            out.write(reinterpret_cast<const char*>(pyramid[i].ptr(y)), row);
+            out.write(&padding[0], l.step - row);
+        }
+        written += l.step * l.rows;
+    }
+
+    return bool(out);
+}
+
+/**
+ * Stores pixels as a raw frame.
+ * @return false If the type is not supported or could not write.
+ */
+inline bool saveRaw(const std::string& path, const cv::Mat& image) {
+    if (image.empty() || !isRawType(image.type())) {
+        return false;
+    }
+
+    std::ofstream out(path.c_str(), std::ios::binary);
+    RawHeader h;
+    memcpy(h.magic, RAW_MAGIC, sizeof(RAW_MAGIC));
+    h.rows = image.rows;
+    h.cols = image.cols;
+    h.type = image.type();
+    out.write(reinterpret_cast<const char*>(&h), sizeof(h));
+    for (int y = 0; y < image.rows; ++y) {
+        out.write(reinterpret_cast<const char*>(image.ptr(y)), image.cols * image.elemSize());
+    }
+
+    return bool(out);
+}
+
+} // namespace imgio
+
+#endif
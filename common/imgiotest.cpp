@@ -0,0 +1,196 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Round trip of both raw formats of imgio: images are saved as frames and containers, loaded back
+ * and compared pixel by pixel. Truncated and damaged headers must be rejected.
+ */
+
+#include "check.h"
+#include "imgio.h"
+
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * @return true If both images have the same dimensions, type and pixels.
+ */
+bool same(const Mat& a, const Mat& b) {
+    return a.size() == b.size() && a.type() == b.type() && (a.empty() || norm(a, b, NORM_INF) == 0);
+}
+
+vector<unsigned char> readBytes(const string& path) {
+    imgio::MappedFile file;
+    if (!file.open(path)) {
+        return vector<unsigned char>();
+    }
+
+    return vector<unsigned char>(file.data(), file.data() + file.size());
+}
+
+/**
+ * @return Grayscale version of a BGR image and the other way round, as imread() would return.
+ */
+Mat converted(const Mat& image) {
+    Mat result;
+    cvtColor(image, result, image.channels() == 3 ? CV_BGR2GRAY : CV_GRAY2BGR);
+
+    return result;
+}
+
+void testFrame(const string& dir, const Mat& image) {
+    string path = dir + "/frame.raw";
+    if (!CHECK(imgio::saveRaw(path, image))) {
+        return;
+    }
+
+    vector<unsigned char> bytes = readBytes(path);
+    CHECK(bytes.size() == sizeof(imgio::RawHeader) + image.total() * image.elemSize());
+    CHECK(imgio::isRaw(&bytes[0], bytes.size()));
+    CHECK(same(imgio::load(path, CV_LOAD_IMAGE_UNCHANGED), image));
+    int other = image.channels() == 3 ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR;
+    CHECK(same(imgio::load(path, other), converted(image)));
+
+    imgio::Image loaded;
+    CHECK(imgio::open(path, loaded, CV_LOAD_IMAGE_UNCHANGED));
+    CHECK(same(loaded.pixels, image));
+    CHECK(!loaded.mapped && loaded.levels.empty());
+
+    // A frame missing its last pixel is not raw and not anything else either.
+    CHECK(!imgio::isRaw(&bytes[0], bytes.size() - 1));
+    CHECK(imgio::decode(&bytes[0], bytes.size() - 1, CV_LOAD_IMAGE_UNCHANGED).empty());
+}
+
+void testContainer(const string& dir, const Mat& image, int levels) {
+    string path = dir + "/container.raw";
+    if (!CHECK(imgio::saveContainer(path, image, levels))) {
+        return;
+    }
+
+    vector<Mat> pyramid(1, image);
+    for (int i = 1; i < levels && pyramid.back().rows > 1 && pyramid.back().cols > 1; ++i) {
+        Mat down;
+        pyrDown(pyramid.back(), down);
+        pyramid.push_back(down);
+    }
+
+    vector<unsigned char> bytes = readBytes(path);
+    CHECK(imgio::isContainer(&bytes[0], bytes.size()));
+    CHECK(same(imgio::decode(&bytes[0], bytes.size(), CV_LOAD_IMAGE_UNCHANGED), image));
+
+    imgio::Image loaded;
+    if (CHECK(imgio::open(path, loaded, CV_LOAD_IMAGE_UNCHANGED))) {
+        CHECK(loaded.mapped && loaded.file);
+        CHECK(same(loaded.pixels, image));
+        CHECK(loaded.levels.size() + 1 == pyramid.size());
+        for (size_t i = 0; i < loaded.levels.size() && i + 1 < pyramid.size(); ++i) {
+            CHECK(same(loaded.levels[i], pyramid[i + 1]));
+        }
+        CHECK((loaded.pixels.data - loaded.file->data()) % imgio::CONTAINER_ALIGN == 0);
+        CHECK(loaded.pixels.step % imgio::CONTAINER_ALIGN == 0);
+    }
+
+    int other = image.channels() == 3 ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR;
+    if (CHECK(imgio::open(path, loaded, other))) {
+        CHECK(!loaded.mapped);
+        CHECK(same(loaded.pixels, converted(image)));
+    }
+
+    CHECK(!imgio::isContainer(&bytes[0], bytes.size() - 1));
+
+    // Damaged headers.
+    imgio::ContainerHeader h;
+    memcpy(&h, &bytes[0], sizeof(h));
+    vector<unsigned char> damaged = bytes;
+    imgio::ContainerHeader d = h;
+    d.level[0].offset += 1;
+    memcpy(&damaged[0], &d, sizeof(d));
+    CHECK(!imgio::isContainer(&damaged[0], damaged.size()));
+    d = h;
+    d.levels = 0;
+    memcpy(&damaged[0], &d, sizeof(d));
+    CHECK(!imgio::isContainer(&damaged[0], damaged.size()));
+    d = h;
+    d.levels = imgio::CONTAINER_MAX_LEVELS + 1;
+    memcpy(&damaged[0], &d, sizeof(d));
+    CHECK(!imgio::isContainer(&damaged[0], damaged.size()));
+    d = h;
+    d.level[0].rows = 0x7fffffff;
+    memcpy(&damaged[0], &d, sizeof(d));
+    CHECK(!imgio::isContainer(&damaged[0], damaged.size()));
+    d = h;
+    d.level[0].step = 0xffffffffffffffc0ull;
+    memcpy(&damaged[0], &d, sizeof(d));
+    CHECK(!imgio::isContainer(&damaged[0], damaged.size()));
+    d = h;
+    d.level[0].type = CV_16UC1;
+    memcpy(&damaged[0], &d, sizeof(d));
+    CHECK(!imgio::isContainer(&damaged[0], damaged.size()));
+}
+
+void testDamagedFrame() {
+    imgio::RawHeader h;
+    memcpy(h.magic, imgio::RAW_MAGIC, sizeof(imgio::RAW_MAGIC));
+    h.rows = 0x80000000u;
+    h.cols = 0x80000000u;
+    h.type = CV_8UC3;
+    vector<unsigned char> bytes(sizeof(h) + 64, 0);
+    memcpy(&bytes[0], &h, sizeof(h));
+    CHECK(!imgio::isRaw(&bytes[0], bytes.size()));
+
+    h.rows = 4;
+    h.cols = 4;
+    h.type = CV_32FC1;
+    memcpy(&bytes[0], &h, sizeof(h));
+    CHECK(!imgio::isRaw(&bytes[0], bytes.size()));
+
+    h.type = CV_8UC1;
+    h.rows = 0;
+    memcpy(&bytes[0], &h, sizeof(h));
+    CHECK(!imgio::isRaw(&bytes[0], bytes.size()));
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " directory-for-temporary-files" << endl;
+        return 1;
+    }
+    string dir = argv[1];
+
+    RNG rng(0x5350524c);
+    Size sizes[] = {Size(1, 1), Size(13, 7), Size(64, 64), Size(101, 37)};
+    int types[] = {CV_8UC1, CV_8UC3};
+    int levels[] = {1, 3, imgio::CONTAINER_MAX_LEVELS};
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); ++s) {
+        for (size_t t = 0; t < sizeof(types) / sizeof(types[0]); ++t) {
+            Mat image(sizes[s], types[t]);
+            rng.fill(image, RNG::UNIFORM, 0, 256);
+            testFrame(dir, image);
+            for (size_t l = 0; l < sizeof(levels) / sizeof(levels[0]); ++l) {
+                testContainer(dir, image, levels[l]);
+            }
+
+            // Rows of a submatrix are not contiguous, saved pixels must not include the gaps.
+            Mat wide(sizes[s].height, sizes[s].width + 5, types[t]);
+            rng.fill(wide, RNG::UNIFORM, 0, 256);
+            Mat view = wide(Rect(2, 0, sizes[s].width, sizes[s].height));
+            testFrame(dir, view);
+            testContainer(dir, view, 2);
+        }
+    }
+    testDamagedFrame();
+
+    Mat unsupported(4, 4, CV_16UC1, Scalar(1));
+    CHECK(!imgio::saveRaw(dir + "/unsupported.raw", unsupported));
+    CHECK(!imgio::saveContainer(dir + "/unsupported.raw", unsupported));
+    CHECK(!imgio::saveContainer(dir + "/unsupported.raw", Mat(4, 4, CV_8UC1), 0));
+    CHECK(!imgio::saveContainer(dir + "/unsupported.raw", Mat(4, 4, CV_8UC1), imgio::CONTAINER_MAX_LEVELS + 1));
+
+    return check::report("imgiotest");
+}
@@ -0,0 +1,59 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Command line application that converts images to raw containers,
+ * so fd, shapes and tpl can use them without decoding.
+ */
+
+#include "imgio.h"
+
+#include <cstdlib>
+#include <iostream>
+#include <string>
+
+using namespace cv;
+using namespace std;
+
+void showHelp(const char *appName) {
+    cerr << "Converts an image to a raw container with optional pyramid levels.\n" <<
+        "Usage: " << appName << " [-l LEVELS] [-g] input output\n" <<
+        "  -l LEVELS  Number of levels including the image itself, 1 by default.\n" <<
+        "  -g         Store grayscale pixels instead of BGR.\n" <<
+        "Using OpenCV version " << CV_VERSION << "\n";
+}
+
+int main(int argc, const char** argv) {
+    int levels = 1;
+    int flags = CV_LOAD_IMAGE_COLOR;
+    int i = 1;
+    for (; i < argc && argv[i][0] == '-'; ++i) {
+        string arg = argv[i];
+        if (arg == "-l" && i + 1 < argc) {
+            levels = atoi(argv[++i]);
+        } else if (arg == "-g") {
+            flags = CV_LOAD_IMAGE_GRAYSCALE;
+        } else {
+            break;
+        }
+    }
+    if (argc - i != 2 || levels < 1 || levels > imgio::CONTAINER_MAX_LEVELS) {
+        showHelp(argv[0]);
+        return 1;
+    }
+
+    Mat image = imgio::load(argv[i], flags);
+    if (image.empty()) {
+        cerr << "Couldn't load image " << argv[i] << endl;
+        return 1;
+    }
+
+    if (!imgio::saveContainer(argv[i + 1], image, levels)) {
+        cerr << "Couldn't write " << argv[i + 1] << endl;
+        return 1;
+    }
+
+    return 0;
+}
@@ -0,0 +1,221 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Cascades behind one interface, so fd and its benchmarks run the same evaluators:
+ * CascadeClassifier of OpenCV or the built-in ones of haar.h.
+ */
+
+#ifndef SULPRE_FD_BACKEND_H
+#define SULPRE_FD_BACKEND_H
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "../common/imgio.h"
+#include "compiled.h"
+#include "haar.h"
+
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+/**
+ * Cascade used by Detector to find objects of different sizes.
+ */
+class CascadeBackend {
+public:
+
+    virtual ~CascadeBackend() {}
+
+    /**
+     * @param Equalized grayscale image
+     * @param Found objects
+     * @param How much the image is scaled down at each step
+     * @param Minimum number of neighbors each candidate should have to be kept
+     * @param Minimum object size
+     */
+    virtual void detectMultiScale(const cv::Mat& gray, std::vector<cv::Rect>& objects, double scaleFactor,
+        int minNeighbors, cv::Size minSize) = 0;
+
+    /**
+     * Detects objects inside a region reusing scaled images and integrals of the pyramid.
+     * @param Pyramid of the equalized grayscale image
+     * @param Region of the image
+     * @param Found objects in coordinates of the image
+     * @param Minimum number of neighbors each candidate should have to be kept
+     * @param Minimum object size
+     * @return false If the backend cannot use pyramids, nothing is detected then.
+     */
+    virtual bool detectMultiScale(haar::Pyramid& pyramid, const cv::Rect& roi, std::vector<cv::Rect>& objects,
+        int minNeighbors, cv::Size minSize) {
+        return false;
+    }
+};
+
+/**
+ * CascadeClassifier of OpenCV.
+ */
+class OpenCVBackend : public CascadeBackend {
+public:
+
+    bool load(const std::string& filename) {
+        return mCascade.load(filename);
+    }
+
+    virtual void detectMultiScale(const cv::Mat& gray, std::vector<cv::Rect>& objects, double scaleFactor,
+        int minNeighbors, cv::Size minSize) {
+        mCascade.detectMultiScale(gray, objects, scaleFactor, minNeighbors, 0|CV_HAAR_SCALE_IMAGE, minSize);
+    }
+
+private:
+
+    cv::CascadeClassifier mCascade;
+};
+
+/**
+ * Built-in evaluators of haar.h: SSE2 one for any cascade or one generated for a bundled cascade.
+ * Cascades are loaded once and shared by all detectors.
+ */
+class HaarBackend : public CascadeBackend {
+public:
+
+    /**
+     * Takes ownership of the classifier, SimdClassifier is used if 0.
+     */
+    HaarBackend(const std::shared_ptr<const haar::Cascade>& cascade, haar::Classifier* classifier = 0)
+        : mCascade(cascade), mClassifier(classifier ? classifier : new haar::SimdClassifier(*cascade)) {}
+
+    virtual void detectMultiScale(const cv::Mat& gray, std::vector<cv::Rect>& objects, double scaleFactor,
+        int minNeighbors, cv::Size minSize) {
+        mClassifier->detectMultiScale(gray, objects, scaleFactor, minNeighbors, minSize);
+    }
+
+    virtual bool detectMultiScale(haar::Pyramid& pyramid, const cv::Rect& roi, std::vector<cv::Rect>& objects,
+        int minNeighbors, cv::Size minSize) {
+        mClassifier->detectMultiScale(pyramid, roi, objects, minNeighbors, minSize);
+        return true;
+    }
+
+    /**
+     * Loads a cascade or returns already loaded one.
+     * @return 0 If could not load.
+     */
+    static std::shared_ptr<const haar::Cascade> load(const std::string& filename) {
+        static std::mutex m;
+        static std::map<std::string, std::shared_ptr<const haar::Cascade> > loaded;
+        std::lock_guard<std::mutex> lock(m);
+        std::shared_ptr<const haar::Cascade>& cascade = loaded[filename];
+        if (!cascade) {
+            std::shared_ptr<haar::Cascade> c = std::make_shared<haar::Cascade>();
+            if (c->load(filename)) {
+                cascade = c;
+            }
+        }
+
+        return cascade;
+    }
+
+private:
+
+    std::shared_ptr<const haar::Cascade> mCascade;
+    std::unique_ptr<haar::Classifier> mClassifier;
+};
+
+/**
+ * Implementation of cascades.
+ */
+enum Backend {
+    /**
+     * Built-in for binary cascades, OpenCV for XML.
+     */
+    BACKEND_AUTO,
+    BACKEND_OPENCV,
+    BACKEND_NATIVE,
+    BACKEND_COMPILED
+};
+
+/**
+ * Reads a backend by its name on the command line: opencv, native or compiled.
+ * @return false If the name is unknown.
+ */
+inline bool parseBackend(const std::string& name, Backend& backend) {
+    if (name == "opencv") {
+        backend = BACKEND_OPENCV;
+    } else if (name == "native") {
+        backend = BACKEND_NATIVE;
+    } else if (name == "compiled") {
+        backend = BACKEND_COMPILED;
+    } else {
+        return false;
+    }
+
+    return true;
+}
+
+/**
+ * Factory to create a cascade.
+ * @return 0 If could not load.
+ */
+inline CascadeBackend* createCascade(const char* filename, Backend backend) {
+    if (backend == BACKEND_AUTO) {
+        imgio::MappedFile file;
+        bool binary = file.open(filename) && file.size() >= sizeof(haar::MAGIC) &&
+            memcmp(file.data(), haar::MAGIC, sizeof(haar::MAGIC)) == 0;
+        backend = binary ? BACKEND_NATIVE : BACKEND_OPENCV;
+    }
+
+    if (backend == BACKEND_NATIVE) {
+        std::shared_ptr<const haar::Cascade> cascade = HaarBackend::load(filename);
+        return cascade ? new HaarBackend(cascade) : 0;
+    }
+
+    if (backend == BACKEND_COMPILED) {
+        std::shared_ptr<const haar::Cascade> cascade = HaarBackend::load(filename);
+        haar::Classifier* classifier = cascade ? haar::compiled::create(*cascade) : 0;
+        if (classifier == 0) {
+            std::cerr << "No compiled evaluator for " << filename << std::endl;
+            return 0;
+        }
+
+        return new HaarBackend(cascade, classifier);
+    }
+
+    OpenCVBackend* cascade = new OpenCVBackend;
+    if (!cascade->load(filename)) {
+        delete cascade;
+        return 0;
+    }
+
+    return cascade;
+}
+
+/**
+ * Detects objects inside a region, like eyes inside a face or faces inside a tile.
+ * @param Cascade
+ * @param Pyramid of the image, used if given and the cascade can
+ * @param Equalized grayscale image
+ * @param Region
+ * @param Minimum object size
+ * @param Found objects in coordinates of the image
+ */
+inline void findIn(CascadeBackend* cascade, haar::Pyramid* pyramid, const cv::Mat& gray, const cv::Rect& region,
+    cv::Size minSize, std::vector<cv::Rect>& objects) {
+    if (pyramid && cascade->detectMultiScale(*pyramid, region, objects, 2, minSize)) {
+        return;
+    }
+
+    cv::Mat roi = gray(region);
+    cascade->detectMultiScale(roi, objects, 1.1, 2, minSize);
+    for (size_t j = 0; j < objects.size(); ++j) {
+        objects[j] = objects[j] + region.tl();
+    }
+}
+
+#endif
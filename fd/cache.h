@@ -0,0 +1,344 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Persistent cache of detection results.
+ */
+
+#ifndef SULPRE_FD_CACHE_H
+#define SULPRE_FD_CACHE_H
+
+#include "opencv2/core/core.hpp"
+
+#include "../common/imgio.h"
+
+#include <cstdio>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <sys/stat.h>
+
+/**
+ * First word of a cache file.
+ */
+const char CACHE_SETTINGS[] = "settings";
+
+/**
+ * Remembers faces and eyes found in files, so unchanged files need neither decoding nor detection.
+ * A file is considered unchanged if its size and modification time are the same as before,
+ * otherwise if the hash of its content is known (the file was touched, copied or renamed).
+ *
+ * Results depend on detection settings too, so the cache is bound to a fingerprint of them
+ * and a cache made with other settings is discarded as a whole.
+ *
+ * Only files looked up or stored during the run are saved, results of deleted or moved away files don't pile up.
+ *
+ * Stored as text, the fingerprint on the first line, then one file per line:
+ * settings fingerprint
+ * hash size mtime faces-count x y w h ... eyes-count x y w h ... path
+ * Paths with a line break are never stored.
+ */
+class ResultCache {
+public:
+
+    /**
+     * @param Description of all settings that change results: cascades, backend, detection options.
+     */
+    explicit ResultCache(const std::string& settings = std::string())
+        : mSettings(hash(reinterpret_cast<const unsigned char*>(settings.data()), settings.size())),
+        mFastHits(0), mHashHits(0), mMisses(0), mDiscarded(false), mChanged(false) {}
+
+    /**
+     * Loads the cache from a file. Missing file or a file made with other settings means empty cache.
+     * @return false If the file exists but is broken.
+     */
+    bool load(const std::string& filename) {
+        std::ifstream in(filename.c_str());
+        if (!in) {
+            return true;
+        }
+
+        std::string line;
+        if (!std::getline(in, line)) {
+            return true;
+        }
+        std::istringstream header(line);
+        std::string word;
+        uint64_t settings;
+        if (!(header >> word >> settings) || word != CACHE_SETTINGS) {
+            return false;
+        }
+        if (settings != mSettings) {
+            // Rewritten even if nothing is found, old results must not come back.
+            mDiscarded = true;
+            mChanged = true;
+            return true;
+        }
+
+        while (std::getline(in, line)) {
+            std::istringstream is(line);
+            Entry e;
+            if (!(is >> e.hash >> e.size >> e.mtime)) {
+                return false;
+            }
+            // Every rectangle takes at least 8 characters, more can't be in the line.
+            size_t limit = line.size() / 8;
+            if (!readRects(is, limit, e.faces) || !readRects(is, limit, e.eyes)) {
+                // A count out of range or broken rectangles: the file is a miss and the line is dropped on save.
+                mChanged = true;
+                continue;
+            }
+            is.get();
+            std::string path;
+            std::getline(is, path);
+            if (path.empty()) {
+                return false;
+            }
+            mByPath[path] = e;
+            mByHash[e.hash] = e;
+        }
+
+        return true;
+    }
+
+    /**
+     * Writes the cache to a file if anything changed.
+     * @return false If could not write.
+     */
+    bool save(const std::string& filename) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        bool unseen = false;
+        for (std::map<std::string, Entry>::const_iterator it = mByPath.begin(); it != mByPath.end(); ++it) {
+            unseen = unseen || !it->second.seen;
+        }
+        if (!mChanged && !unseen) {
+            return true;
+        }
+
+        // Write next to the old one and replace it, so an interrupted run never breaks the cache.
+        std::string tmp = filename + ".tmp";
+        {
+            std::ofstream out(tmp.c_str());
+            out << CACHE_SETTINGS << ' ' << mSettings << '\n';
+            for (std::map<std::string, Entry>::const_iterator it = mByPath.begin(); it != mByPath.end(); ++it) {
+                const Entry& e = it->second;
+                if (!e.seen) {
+                    continue;
+                }
+                out << e.hash << ' ' << e.size << ' ' << e.mtime;
+                writeRects(out, e.faces);
+                writeRects(out, e.eyes);
+                out << ' ' << it->first << '\n';
+            }
+            if (!out) {
+                return false;
+            }
+        }
+
+        return rename(tmp.c_str(), filename.c_str()) == 0;
+    }
+
+    /**
+     * Looks for known results of the file.
+     * @param Path to file
+     * @param Its current stat
+     * @param Found faces
+     * @param Found eyes
+     * @param Hash of content if it had to be computed, 0 otherwise. Pass it to store().
+     * @return true If results are known.
+     */
+    bool lookup(const std::string& path, const struct stat& st,
+        std::vector<cv::Rect>& faces, std::vector<cv::Rect>& eyes, uint64_t& hash) {
+        hash = 0;
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            std::map<std::string, Entry>::iterator it = mByPath.find(path);
+            if (it != mByPath.end() && it->second.size == st.st_size && it->second.mtime == mtime(st)) {
+                it->second.seen = true;
+                // Assigned into vectors of the caller, that keep their memory from earlier images.
+                faces.assign(it->second.faces.begin(), it->second.faces.end());
+                eyes.assign(it->second.eyes.begin(), it->second.eyes.end());
+                ++mFastHits;
+                return true;
+            }
+        }
+
+        hash = hashFile(path);
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::map<uint64_t, Entry>::const_iterator it = mByHash.find(hash);
+        if (hash == 0 || it == mByHash.end() || it->second.size != st.st_size) {
+            ++mMisses;
+            return false;
+        }
+
+        faces.assign(it->second.faces.begin(), it->second.faces.end());
+        eyes.assign(it->second.eyes.begin(), it->second.eyes.end());
+        ++mHashHits;
+
+        // Next time the fast path will do.
+        if (storable(path)) {
+            Entry e = it->second;
+            e.mtime = mtime(st);
+            e.seen = true;
+            mByPath[path] = e;
+            mChanged = true;
+        }
+
+        return true;
+    }
+
+    /**
+     * Remembers results of the file.
+     * @param Hash returned by lookup() or 0 to compute it.
+     */
+    void store(const std::string& path, const struct stat& st,
+        const std::vector<cv::Rect>& faces, const std::vector<cv::Rect>& eyes, uint64_t hash) {
+        if (!storable(path)) {
+            return;
+        }
+        if (hash == 0) {
+            hash = hashFile(path);
+        }
+        if (hash == 0) {
+            return;
+        }
+
+        Entry e;
+        e.hash = hash;
+        e.size = st.st_size;
+        e.mtime = mtime(st);
+        e.faces = faces;
+        e.eyes = eyes;
+        e.seen = true;
+
+        std::lock_guard<std::mutex> lock(mMutex);
+        mByPath[path] = e;
+        mByHash[hash] = e;
+        mChanged = true;
+    }
+
+    /**
+     * Prints hit counters.
+     */
+    void report(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        out << "cache: " << mFastHits << " unchanged, " << mHashHits << " same content, " <<
+            mMisses << " misses, " << mByPath.size() << " entries";
+        if (mDiscarded) {
+            out << ", old results of other settings discarded";
+        }
+        out << std::endl;
+    }
+
+    /**
+     * FNV-1a hash of file content.
+     * @return 0 If could not read.
+     */
+    static uint64_t hashFile(const std::string& path) {
+        imgio::MappedFile file;
+        if (!file.open(path)) {
+            return 0;
+        }
+
+        return hash(file.data(), file.size());
+    }
+
+    /**
+     * FNV-1a hash of bytes, never 0.
+     */
+    static uint64_t hash(const unsigned char* p, size_t size) {
+        uint64_t h = 14695981039346656037ULL;
+        for (size_t i = 0; i < size; ++i) {
+            h = (h ^ p[i]) * 1099511628211ULL;
+        }
+
+        return h ? h : 1;
+    }
+
+private:
+
+    /**
+     * @return false If the path can't be stored in a line.
+     */
+    static bool storable(const std::string& path) {
+        return path.find('\n') == std::string::npos;
+    }
+
+    struct Entry {
+        Entry() : hash(0), size(0), mtime(0), seen(false) {}
+
+        uint64_t hash;
+        long long size;
+
+        /**
+         * Modification time in nanoseconds.
+         */
+        long long mtime;
+
+        std::vector<cv::Rect> faces;
+        std::vector<cv::Rect> eyes;
+
+        /**
+         * Looked up or stored during this run, only such entries are saved.
+         */
+        bool seen;
+    };
+
+    static long long mtime(const struct stat& st) {
+        return st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec;
+    }
+
+    /**
+     * @param Stream
+     * @param Maximum number of rectangles
+     * @param Read rectangles
+     * @return false If could not read or there are more rectangles than the maximum.
+     */
+    static bool readRects(std::istream& in, size_t limit, std::vector<cv::Rect>& rects) {
+        size_t n;
+        if (!(in >> n) || n > limit) {
+            return false;
+        }
+        rects.resize(n);
+        for (size_t i = 0; i < n; ++i) {
+            if (!(in >> rects[i].x >> rects[i].y >> rects[i].width >> rects[i].height)) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    static void writeRects(std::ostream& out, const std::vector<cv::Rect>& rects) {
+        out << ' ' << rects.size();
+        for (size_t i = 0; i < rects.size(); ++i) {
+            out << ' ' << rects[i].x << ' ' << rects[i].y << ' ' << rects[i].width << ' ' << rects[i].height;
+        }
+    }
+
+    /**
+     * Fingerprint of detection settings.
+     */
+    uint64_t mSettings;
+
+    std::map<std::string, Entry> mByPath;
+    std::map<uint64_t, Entry> mByHash;
+    size_t mFastHits;
+    size_t mHashHits;
+    size_t mMisses;
+
+    /**
+     * If the file was made with other settings.
+     */
+    bool mDiscarded;
+    bool mChanged;
+    mutable std::mutex mMutex;
+};
+
+#endif
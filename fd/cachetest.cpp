@@ -0,0 +1,117 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * ResultCache round trip: stored results are found after save and load, results of files not seen
+ * during a run are not saved again, and damaged rectangle counts make a miss instead of an allocation.
+ */
+
+#include "../common/check.h"
+#include "cache.h"
+
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+const char SETTINGS[] = "cachetest";
+
+string writeFile(const string& path, const string& content) {
+    ofstream out(path.c_str(), ios::binary);
+    out << content;
+
+    return path;
+}
+
+struct stat statOf(const string& path) {
+    struct stat st;
+    memset(&st, 0, sizeof(st));
+    stat(path.c_str(), &st);
+
+    return st;
+}
+
+/**
+ * @return true If the cache has the results of the file.
+ */
+bool found(ResultCache& cache, const string& path, const vector<Rect>& faces) {
+    vector<Rect> foundFaces;
+    vector<Rect> foundEyes;
+    uint64_t hash;
+
+    return cache.lookup(path, statOf(path), foundFaces, foundEyes, hash) && foundFaces == faces && foundEyes.empty();
+}
+
+/**
+ * Line of the cache file for the file with \a count in place of the number of faces.
+ */
+string line(const string& path, const string& count) {
+    struct stat st = statOf(path);
+    ostringstream out;
+    out << ResultCache::hashFile(path) << ' ' << st.st_size << ' ' <<
+        st.st_mtim.tv_sec * 1000000000LL + st.st_mtim.tv_nsec << ' ' << count << " 1 2 3 4 0 " << path << '\n';
+
+    return out.str();
+}
+
+void testPruning(const string& dir) {
+    string a = writeFile(dir + "/a.jpg", "a");
+    string b = writeFile(dir + "/b.jpg", "bb");
+    string cacheFile = dir + "/cache";
+    vector<Rect> faces(1, Rect(1, 2, 3, 4));
+    {
+        ResultCache cache(SETTINGS);
+        cache.store(a, statOf(a), faces, vector<Rect>(), 0);
+        cache.store(b, statOf(b), faces, vector<Rect>(), 0);
+        CHECK(cache.save(cacheFile));
+    }
+    {
+        ResultCache cache(SETTINGS);
+        CHECK(cache.load(cacheFile));
+        CHECK(found(cache, a, faces));
+        CHECK(cache.save(cacheFile));
+    }
+    {
+        ResultCache cache(SETTINGS);
+        CHECK(cache.load(cacheFile));
+        CHECK(!found(cache, b, faces));
+        CHECK(found(cache, a, faces));
+    }
+}
+
+void testDamagedCounts(const string& dir) {
+    string a = writeFile(dir + "/a.jpg", "a");
+    string b = writeFile(dir + "/b.jpg", "bb");
+    vector<Rect> faces(1, Rect(1, 2, 3, 4));
+    const char* counts[] = {"1000000000000", "-1", "99999999999999999999999", "2"};
+    for (size_t i = 0; i < sizeof(counts) / sizeof(counts[0]); ++i) {
+        string cacheFile = dir + "/damaged";
+        ostringstream content;
+        content << CACHE_SETTINGS << ' ' << ResultCache::hash(reinterpret_cast<const unsigned char*>(SETTINGS),
+            strlen(SETTINGS)) << '\n' << line(a, counts[i]) << line(b, "1");
+        writeFile(cacheFile, content.str());
+
+        ResultCache cache(SETTINGS);
+        CHECK(cache.load(cacheFile));
+        CHECK(!found(cache, a, faces));
+        CHECK(found(cache, b, faces));
+    }
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " directory-for-temporary-files" << endl;
+        return 1;
+    }
+    string dir = argv[1];
+
+    testPruning(dir);
+    testDamagedCounts(dir);
+
+    return check::report("cachetest");
+}
@@ -0,0 +1,64 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Command line application that compiles an OpenCV Haar cascade XML into the binary format of fd,
+ * which is used right from the mapping without parsing.
+ */
+
+#include "haar.h"
+
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+void showHelp(const char *appName) {
+    cerr << "Compiles a Haar cascade XML into a binary cascade for fd.\n" <<
+        "Usage: " << appName << " input.xml output.bin\n" <<
+        "Using OpenCV version " << CV_VERSION << "\n";
+}
+
+/**
+ * @return Milliseconds it took to load the cascade.
+ */
+double measure(const string& filename, bool& ok) {
+    int64 start = getTickCount();
+    haar::Cascade cascade;
+    ok = cascade.load(filename);
+
+    return (getTickCount() - start) * 1000. / getTickFrequency();
+}
+
+int main(int argc, const char** argv) {
+    if (argc != 3) {
+        showHelp(argv[0]);
+        return 1;
+    }
+
+    haar::Cascade cascade;
+    if (!cascade.load(argv[1])) {
+        cerr << "Couldn't load cascade " << argv[1] << endl;
+        return 1;
+    }
+    if (!cascade.save(argv[2])) {
+        cerr << "Couldn't write " << argv[2] << endl;
+        return 1;
+    }
+
+    bool ok;
+    double xmlMs = measure(argv[1], ok);
+    double binMs = measure(argv[2], ok);
+    if (!ok) {
+        cerr << "Couldn't load written cascade " << argv[2] << endl;
+        return 1;
+    }
+
+    cout << argv[2] << ": " << cascade.stageCount() << " stages, " << cascade.treeCount() << " trees, " <<
+        cascade.nodeCount() << " nodes, " << cascade.featureCount() << " features" << endl;
+    cout << "load time: xml " << xmlMs << " ms, binary " << binMs << " ms" << endl;
+
+    return 0;
+}
@@ -0,0 +1,200 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Command line application that turns Haar cascades into C++:
+ * every stage, tree and feature becomes straight code with thresholds, weights and
+ * rectangle corners as constants, evaluated by haar::CompiledClassifier.
+ */
+
+#include "haar.h"
+
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+void showHelp(const char *appName) {
+    cerr << "Generates C++ evaluators of Haar cascades for fd.\n" <<
+        "Usage: " << appName << " output.h Name=cascade.xml [Name=cascade.xml ...]\n" <<
+        "Using OpenCV version " << CV_VERSION << "\n";
+}
+
+/**
+ * Prints a number so it is read back exactly as double.
+ */
+string literal(double value) {
+    char buf[32];
+    snprintf(buf, sizeof(buf), "%.17g", value);
+
+    return buf;
+}
+
+/**
+ * Writes C++ of one cascade.
+ */
+class Generator {
+public:
+
+    Generator(const haar::Cascade& cascade, ostream& out) : mCascade(cascade), mOut(out) {
+        haar::Classifier::weights(cascade, mWeights);
+    }
+
+    void generate(const string& name, const string& source) {
+        mOut << "/**\n * " << source << ": " << mCascade.stageCount() << " stages, " << mCascade.treeCount() <<
+            " trees, " << mCascade.nodeCount() << " nodes.\n */\n";
+        mOut << "struct " << name << " {\n";
+        mOut << "    static const uint64_t HASH = " << mCascade.hash() << "ULL;\n\n";
+        mOut << "    static bool evaluate(const int* s, const int* t, int step, double norm) {\n";
+        mOut << "        double sum;\n";
+        mOut << "        double v;\n";
+
+        const haar::Stage* stages = mCascade.stages();
+        for (size_t i = 0; i < mCascade.stageCount(); ++i) {
+            mOut << "\n        // Stage " << i << ", " << stages[i].treeCount << " trees.\n";
+            mOut << "        sum = 0;\n";
+            for (int t = stages[i].firstTree; t < stages[i].firstTree + stages[i].treeCount; ++t) {
+                node(mCascade.trees()[t], 0, 2);
+            }
+            mOut << "        if (sum < " << literal(stages[i].threshold) << " - STAGE_THRESHOLD_BIAS) {\n";
+            mOut << "            return false;\n";
+            mOut << "        }\n";
+        }
+        mOut << "\n        return true;\n";
+        mOut << "    }\n";
+        mOut << "};\n\n";
+    }
+
+private:
+
+    /**
+     * Writes the node \a idx of the tree and its children.
+     */
+    void node(const haar::Tree& tree, int idx, int depth) {
+        string indent(depth * 4, ' ');
+        const haar::Node& n = mCascade.nodes()[tree.firstNode + idx];
+        mOut << indent << "v = " << feature(n.feature) << ";\n";
+        string condition = "v < " + literal(n.threshold) + " * norm";
+        if (n.left <= 0 && n.right <= 0) {
+            mOut << indent << "sum += " << condition << " ? " << leaf(tree, n.left) << " : " << leaf(tree, n.right) << ";\n";
+            return;
+        }
+
+        mOut << indent << "if (" << condition << ") {\n";
+        child(tree, n.left, depth + 1);
+        mOut << indent << "} else {\n";
+        child(tree, n.right, depth + 1);
+        mOut << indent << "}\n";
+    }
+
+    void child(const haar::Tree& tree, int idx, int depth) {
+        if (idx > 0) {
+            node(tree, idx, depth);
+        } else {
+            mOut << string(depth * 4, ' ') << "sum += " << leaf(tree, idx) << ";\n";
+        }
+    }
+
+    string leaf(const haar::Tree& tree, int idx) const {
+        return literal(mCascade.leaves()[tree.firstLeaf - idx]);
+    }
+
+    /**
+     * Expression of the feature value, in the same order of operations as Classifier::evaluate().
+     */
+    string feature(int idx) const {
+        const haar::Feature& f = mCascade.features()[idx];
+        string result;
+        for (int k = 0; k < f.count; ++k) {
+            const haar::FeatureRect& r = f.rect[k];
+            int x[4], y[4];
+            if (!f.tilted) {
+                x[0] = r.x; y[0] = r.y;
+                x[1] = r.x + r.width; y[1] = r.y;
+                x[2] = r.x; y[2] = r.y + r.height;
+                x[3] = r.x + r.width; y[3] = r.y + r.height;
+            } else {
+                x[0] = r.x; y[0] = r.y;
+                x[1] = r.x - r.height; y[1] = r.y + r.height;
+                x[2] = r.x + r.width; y[2] = r.y + r.width;
+                x[3] = r.x + r.width - r.height; y[3] = r.y + r.width + r.height;
+            }
+
+            const char* p = f.tilted ? "t" : "s";
+            string corners[4];
+            for (int c = 0; c < 4; ++c) {
+                corners[c] = string("HAAR_AT(") + p + ", " + to_string(x[c]) + ", " + to_string(y[c]) + ")";
+            }
+            if (k > 0) {
+                result += " +\n            ";
+            }
+            result += "(" + corners[0] + " - " + corners[1] + " - " + corners[2] + " + " + corners[3] + ") * " +
+                literal(mWeights[idx * 3 + k]);
+        }
+
+        return result;
+    }
+
+    const haar::Cascade& mCascade;
+    ostream& mOut;
+    vector<float> mWeights;
+};
+
+int main(int argc, const char** argv) {
+    if (argc < 3) {
+        showHelp(argv[0]);
+        return 1;
+    }
+
+    ofstream out(argv[1]);
+    if (!out) {
+        cerr << "Couldn't write " << argv[1] << endl;
+        return 1;
+    }
+
+    out << "/**\n * Generated by fd/cascadegen, do not edit.\n */\n\n";
+    out << "#ifndef SULPRE_FD_CASCADES_H\n#define SULPRE_FD_CASCADES_H\n\n";
+    out << "#include \"haar.h\"\n\n";
+    out << "namespace haar {\nnamespace compiled {\n\n";
+    out << "#define HAAR_AT(p, x, y) p[(y) * step + (x)]\n\n";
+
+    vector<string> names;
+    for (int i = 2; i < argc; ++i) {
+        string arg = argv[i];
+        size_t eq = arg.find('=');
+        if (eq == string::npos) {
+            showHelp(argv[0]);
+            return 1;
+        }
+        string name = arg.substr(0, eq);
+        string source = arg.substr(eq + 1);
+
+        haar::Cascade cascade;
+        if (!cascade.load(source)) {
+            cerr << "Couldn't load cascade " << source << endl;
+            return 1;
+        }
+        Generator(cascade, out).generate(name, source);
+        names.push_back(name);
+        cout << name << ": " << cascade.stageCount() << " stages, " << cascade.treeCount() << " trees" << endl;
+    }
+
+    out << "#undef HAAR_AT\n\n";
+    out << "/**\n * Creates an evaluator of the cascade if it was compiled in.\n" <<
+        " * @return 0 If no generated code matches the cascade.\n */\n";
+    out << "inline Classifier* create(const Cascade& cascade) {\n";
+    out << "    uint64_t hash = cascade.hash();\n";
+    for (size_t i = 0; i < names.size(); ++i) {
+        out << "    if (hash == " << names[i] << "::HASH) {\n";
+        out << "        return new CompiledClassifier<" << names[i] << ">(cascade);\n";
+        out << "    }\n";
+    }
+    out << "\n    return 0;\n}\n\n";
+    out << "} // namespace compiled\n} // namespace haar\n\n#endif\n";
+
+    return out ? 0 : 1;
+}
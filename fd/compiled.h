@@ -0,0 +1,36 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Evaluators of bundled cascades generated by cascadegen into cascades.h.
+ * make.sh generates the header before building fd. Without it, e.g. when fd is built by hand,
+ * nothing is compiled in and haar::compiled::create() finds no evaluator, the other backends still work.
+ */
+
+#ifndef SULPRE_FD_COMPILED_H
+#define SULPRE_FD_COMPILED_H
+
+#include "haar.h"
+
+#ifdef __has_include
+#if __has_include("cascades.h")
+#include "cascades.h"
+#define SULPRE_FD_HAS_CASCADES
+#endif
+#endif
+
+#ifndef SULPRE_FD_HAS_CASCADES
+namespace haar {
+namespace compiled {
+
+inline Classifier* create(const Cascade&) {
+    return 0;
+}
+
+} // namespace compiled
+} // namespace haar
+#endif
+
+#endif
@@ -0,0 +1,188 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Detection quality traded for speed to meet a time budget per image.
+ */
+
+#ifndef SULPRE_FD_DEADLINE_H
+#define SULPRE_FD_DEADLINE_H
+
+#include "opencv2/core/core.hpp"
+
+#include <algorithm>
+#include <cstddef>
+
+/**
+ * Settings of detection that decide its cost.
+ */
+struct Quality {
+    /**
+     * How much the image is scaled down at each step.
+     */
+    double scaleFactor;
+
+    /**
+     * Minimum face size in pixels of the image the cascade runs on.
+     */
+    int minSize;
+
+    /**
+     * If eyes are searched.
+     */
+    bool eyes;
+};
+
+/**
+ * Settings from the best to the fastest one, the first one is what is used without a deadline.
+ */
+const Quality QUALITY_LADDER[] = {
+    {1.1, 30, true},
+    {1.2, 30, true},
+    {1.2, 45, true},
+    {1.3, 45, false},
+    {1.4, 60, false},
+    {1.5, 90, false}
+};
+
+const size_t QUALITY_LEVELS = sizeof(QUALITY_LADDER) / sizeof(QUALITY_LADDER[0]);
+
+/**
+ * Online model of detection time learned from recent images:
+ * the face pass costs the same time per window the cascade is evaluated at, the eye pass costs the same time per face.
+ * Both costs and the number of faces are running averages, so the model follows changes of load and content.
+ * Number of windows is known for any settings before detection, so settings never tried are predicted too.
+ * Faces of tiled images are detected with fixed settings, their pass is modeled apart as time per pixel.
+ * Refining faces on full resolution costs the same time per face whatever the settings.
+ */
+class CostModel {
+public:
+
+    /**
+     * @param Weight of the last image in averages, 0..1
+     */
+    CostModel(double rate = 0.2)
+        : mRate(rate), mImages(0), mWindowImages(0), mTileImages(0), mEyeImages(0), mRefineImages(0), mWindowCost(0),
+        mPixelCost(0), mEyeCost(0), mRefineCost(0), mFaces(0) {}
+
+    /**
+     * @return Number of windows the face cascade is evaluated at on an image of the size.
+     */
+    static double windows(cv::Size size, const Quality& quality) {
+        double result = 0;
+        for (double f = 1; size.width / f >= WINDOW && size.height / f >= WINDOW; f *= quality.scaleFactor) {
+            if (WINDOW * f >= quality.minSize) {
+                result += (size.width / f - WINDOW + 1) * (size.height / f - WINDOW + 1);
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * @param Size of the image the cascade runs on
+     * @param Settings
+     * @param If the image is split into tiles
+     * @return Predicted milliseconds of detection, 0 until something is learned.
+     */
+    double predict(cv::Size size, const Quality& quality, bool tiled = false) const {
+        double faces = tiled ? mPixelCost * size.area() : mWindowCost * windows(size, quality);
+        return faces + mRefineCost * mFaces + (quality.eyes ? mEyeCost * mFaces : 0);
+    }
+
+    /**
+     * @return Index of the best settings in QUALITY_LADDER predicted to finish in time, the fastest ones if none.
+     */
+    size_t choose(cv::Size size, double deadline, bool tiled = false) const {
+        for (size_t i = 0; i < QUALITY_LEVELS; ++i) {
+            if (predict(size, QUALITY_LADDER[i], tiled) <= deadline) {
+                return i;
+            }
+        }
+
+        return QUALITY_LEVELS - 1;
+    }
+
+    /**
+     * Learns from a face pass.
+     * @param Size of the image the cascade ran on
+     * @param Settings used, ignored for tiled images
+     * @param Milliseconds of the face pass alone
+     * @param If the image was split into tiles
+     */
+    void learnFaces(cv::Size size, const Quality& quality, double millis, bool tiled = false) {
+        if (tiled) {
+            average(mPixelCost, millis / std::max(1, size.area()), mTileImages);
+            ++mTileImages;
+        } else {
+            average(mWindowCost, millis / std::max(1., windows(size, quality)), mWindowImages);
+            ++mWindowImages;
+        }
+    }
+
+    /**
+     * Learns from refining faces found on a downscaled image.
+     * @param Faces refined
+     * @param Milliseconds of refining alone
+     */
+    void learnRefine(size_t faces, double millis) {
+        if (faces > 0) {
+            average(mRefineCost, millis / faces, mRefineImages);
+            ++mRefineImages;
+        }
+    }
+
+    /**
+     * Learns from the eye pass of a detection, called for every detection.
+     * @param Settings used
+     * @param Faces found
+     * @param Milliseconds of the eye pass alone
+     */
+    void learnEyes(const Quality& quality, size_t faces, double millis) {
+        average(mFaces, double(faces), mImages);
+        ++mImages;
+        if (quality.eyes && faces > 0) {
+            average(mEyeCost, millis / faces, mEyeImages);
+            ++mEyeImages;
+        }
+    }
+
+private:
+
+    /**
+     * Window of bundled cascades.
+     */
+    static const int WINDOW = 20;
+
+    void average(double& value, double sample, size_t samples) const {
+        value = samples ? value + mRate * (sample - value) : sample;
+    }
+
+    double mRate;
+
+    /**
+     * Numbers of detections, of face passes on whole and on tiled images, of eye passes and of refines learned from.
+     */
+    size_t mImages;
+    size_t mWindowImages;
+    size_t mTileImages;
+    size_t mEyeImages;
+    size_t mRefineImages;
+
+    /**
+     * Milliseconds per window, per pixel of tiled images, per face of the eye pass and per refined face.
+     */
+    double mWindowCost;
+    double mPixelCost;
+    double mEyeCost;
+    double mRefineCost;
+
+    /**
+     * Faces per image.
+     */
+    double mFaces;
+};
+
+#endif
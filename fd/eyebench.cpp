@@ -0,0 +1,157 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Command line application that compares the eye stage of fd on a directory of images:
+ * eyes searched in whole faces for the fixed minimum size against eyes searched in the upper band
+ * of faces for the minimum size scaled to the face. Eyes found in whole faces are the reference for recall.
+ * Cascades run by the same backends as in fd, built-in ones share the pyramid of the image between faces and eyes.
+ */
+
+#include "backend.h"
+#include "eyes.h"
+#include "walker.h"
+
+#include "opencv2/highgui/highgui.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+
+using namespace cv;
+using namespace std;
+
+void showHelp(const char *appName) {
+    cerr << "Compares eye search in whole faces and in upper bands of faces.\n" <<
+        "Usage: " << appName << " face.xml eyes.xml directory [band] [repeats] [backend]\n" <<
+        "Band is the part of the face height from its top, 0.6 by default.\n" <<
+        "Backend is opencv, native or compiled as with fd --backend, chosen by the cascade files by default.\n" <<
+        "Using OpenCV version " << CV_VERSION << "\n";
+}
+
+/**
+ * Timing and results of one way to search eyes.
+ */
+struct Result {
+    const char* name;
+    double ms;
+    size_t eyes;
+    size_t matched;
+};
+
+/**
+ * Minimum face and eye size, the same as of fd.
+ */
+const int MIN_SIZE = 30;
+
+/**
+ * @return Number of rectangles of \a a that overlap by more than a half a rectangle of \a b.
+ */
+size_t matching(const vector<Rect>& a, const vector<Rect>& b) {
+    size_t result = 0;
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (size_t j = 0; j < b.size(); ++j) {
+            if ((a[i] & b[j]).area() * 2 > min(a[i].area(), b[j].area())) {
+                ++result;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 4) {
+        showHelp(argv[0]);
+        return 1;
+    }
+    double band = argc > 4 ? atof(argv[4]) : 0.6;
+    if (band <= 0 || band > 1) {
+        showHelp(argv[0]);
+        return 1;
+    }
+    int repeats = argc > 5 ? atoi(argv[5]) : 3;
+    if (repeats < 1) {
+        repeats = 1;
+    }
+    Backend backend = BACKEND_AUTO;
+    if (argc > 6 && !parseBackend(argv[6], backend)) {
+        showHelp(argv[0]);
+        return 1;
+    }
+
+    unique_ptr<CascadeBackend> faceCascade(createCascade(argv[1], backend));
+    unique_ptr<CascadeBackend> eyesCascade(createCascade(argv[2], backend));
+    if (!faceCascade || !eyesCascade) {
+        cerr << "Couldn't load cascades " << argv[1] << " " << argv[2] << endl;
+        return 1;
+    }
+
+    vector<Mat> images;
+    Walker walker;
+    walker.walk(argv[3], [&images](const string& path, const char*) {
+        Mat image = imread(path, CV_LOAD_IMAGE_GRAYSCALE);
+        if (image.data) {
+            equalizeHist(image, image);
+            images.push_back(image);
+        }
+    });
+    if (images.empty()) {
+        cerr << "No images in " << argv[3] << endl;
+        return 1;
+    }
+
+    Result results[2] = {{"face", 0, 0, 0}, {"band", 0, 0, 0}};
+    Size minSize(MIN_SIZE, MIN_SIZE);
+    size_t faces = 0;
+    size_t below = 0;
+    haar::Pyramid pyramid;
+    for (size_t i = 0; i < images.size(); ++i) {
+        // Faces are found like by fd, so eye levels of built-in backends are already built as there.
+        pyramid.reset(images[i], 1.1);
+        vector<Rect> found;
+        if (!faceCascade->detectMultiScale(pyramid, Rect(0, 0, images[i].cols, images[i].rows), found, 2, minSize)) {
+            faceCascade->detectMultiScale(images[i], found, 1.1, 2, minSize);
+        }
+        faces += found.size();
+        for (size_t f = 0; f < found.size(); ++f) {
+            Rect regions[2] = {found[f], eyeBand(found[f], band)};
+            Size minSizes[2] = {minSize, eyeMinSize(found[f], MIN_SIZE)};
+            vector<Rect> eyes[2];
+            for (int r = 0; r < repeats; ++r) {
+                for (int k = 0; k < 2; ++k) {
+                    int64 start = getTickCount();
+                    eyes[k].clear();
+                    findIn(eyesCascade.get(), &pyramid, images[i], regions[k], minSizes[k], eyes[k]);
+                    results[k].ms += (getTickCount() - start) * 1000. / getTickFrequency();
+                }
+            }
+            for (int k = 0; k < 2; ++k) {
+                results[k].eyes += eyes[k].size();
+                results[k].matched += matching(eyes[0], eyes[k]);
+            }
+
+            // Reference eyes the band can't find.
+            for (size_t e = 0; e < eyes[0].size(); ++e) {
+                if (eyes[0][e].y + eyes[0][e].height / 2 >= regions[1].y + regions[1].height) {
+                    ++below;
+                }
+            }
+        }
+    }
+
+    cout << images.size() << " images, " << faces << " faces, " << repeats << " repeats, band " << band << endl;
+    for (int k = 0; k < 2; ++k) {
+        double perFace = faces ? results[k].ms / (faces * repeats) : 0;
+        cout << results[k].name << ": " << perFace << " ms/face, " << results[k].eyes << " eyes, recall " <<
+            (results[0].eyes ? double(results[k].matched) / results[0].eyes : 0) << ", x" <<
+            (results[k].ms > 0 ? results[0].ms / results[k].ms : 0) << endl;
+    }
+    cout << below << " reference eyes are centered below the band" << endl;
+
+    return 0;
+}
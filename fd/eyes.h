@@ -0,0 +1,47 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Where eyes of a face are searched.
+ */
+
+#ifndef SULPRE_FD_EYES_H
+#define SULPRE_FD_EYES_H
+
+#include "opencv2/core/core.hpp"
+
+#include <algorithm>
+
+/**
+ * Eyes are at least this part of the face width.
+ */
+const double EYE_TO_FACE = 0.15;
+
+/**
+ * @param Face
+ * @param Part of the face height from its top, 1 for the whole face
+ * @return Upper band of the face, the mouth and the chin are below it.
+ */
+inline cv::Rect eyeBand(const cv::Rect& face, double band) {
+    if (band >= 1) {
+        return face;
+    }
+
+    return cv::Rect(face.x, face.y, face.width, std::max(1, cvRound(face.height * band)));
+}
+
+/**
+ * @param Face
+ * @param Minimum eye size searched for in the whole face
+ * @return Minimum size of eyes of the face, never below \a minimum: faces narrower than
+ * minimum / EYE_TO_FACE are searched as thoroughly as without the band.
+ */
+inline cv::Size eyeMinSize(const cv::Rect& face, int minimum) {
+    int size = std::max(minimum, cvRound(face.width * EYE_TO_FACE));
+
+    return cv::Size(size, size);
+}
+
+#endif
@@ -6,101 +6,1470 @@
 /**
  * Command line application that can read a single image or a directory of images and detect all faces + eyes in the image. 
  * Draws rectangle around each face and eye and writes the output to a new file or directory. 
+ * Directories can be processed by a pool of threads or by a pipeline of decoding, detection and encoding.
+ * Videos and cameras are processed frame by frame, faces are tracked between keyframes.
  */
 
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <sstream>
 #include <string>
 #include <iostream>
+#include <limits>
+#include <thread>
 #include <vector>
-#include <dirent.h>
 #include <sys/stat.h>
 
 #include "opencv2/objdetect/objdetect.hpp"
 #include "opencv2/highgui/highgui.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
 
+#include "../common/imgio.h"
+#include "backend.h"
+#include "cache.h"
+#include "compiled.h"
+#include "deadline.h"
+#include "eyes.h"
+#include "gray.h"
+#include "haar.h"
+#include "motion.h"
+#include "prefetch.h"
+#include "queue.h"
+#include "records.h"
+#include "tracker.h"
+#include "walker.h"
+
 using namespace std;
 using namespace cv;
 
+#ifdef FD_COUNT_ALLOCATIONS
+
+/**
+ * Number of operator new calls made by the current thread, to check that processing reuses memory.
+ * Counting replaces the global operator new, so only builds with -DFD_COUNT_ALLOCATIONS do it.
+ */
+thread_local size_t allocations = 0;
+
+void* operator new(size_t size) {
+    ++allocations;
+    void* p = malloc(size ? size : 1);
+    if (!p) {
+        throw bad_alloc();
+    }
+
+    return p;
+}
+
+void operator delete(void* p) noexcept {
+    free(p);
+}
+
+#endif
+
+/**
+ * Faces and eyes found in an image.
+ */
+struct Detection {
+    vector<Rect> faces;
+
+    /**
+     * Eyes in coordinates of the image.
+     */
+    vector<Rect> eyes;
+
+    /**
+     * Settings used, predicted and measured milliseconds of detection when it has a deadline.
+     */
+    Quality quality;
+    double predicted;
+    double elapsed;
+
+    Detection() : quality(QUALITY_LADDER[0]), predicted(0), elapsed(0) {}
+};
+
+/**
+ * Memory a detector reuses from image to image, so a thread that processed a few images
+ * allocates nothing for the next ones of the same or smaller size.
+ */
+struct Scratch {
+    /**
+     * Decoded pixels.
+     */
+    imgio::PixelBuffer pixels;
+    imgio::Image input;
+    Detection detection;
+
+    /**
+     * Counters of allocations, operator new calls are counted with FD_COUNT_ALLOCATIONS only.
+     */
+    size_t images;
+    size_t allocations;
+
+    /**
+     * Images processed without any operator new call.
+     */
+    size_t steady;
+
+    /**
+     * Times pixel buffers had to be allocated again.
+     */
+    size_t reallocations;
+
+    Scratch() : images(0), allocations(0), steady(0), reallocations(0) {}
+
+    void report(ostream& out) const {
+        out << "allocations: " << images << " images, ";
+#ifdef FD_COUNT_ALLOCATIONS
+        out << (images ? double(allocations) / images : 0) << " allocations per image, " << steady <<
+            " images without allocations, ";
+#endif
+        out << reallocations + pixels.growths() << " pixel buffer reallocations" << endl;
+    }
+};
+
+/**
+ * Threads with own cascades that detect objects in regions of one image together with the calling thread:
+ * eyes of different faces or faces in different tiles.
+ */
+class RegionPool {
+public:
+
+    /**
+     * Starts a thread per cascade, takes ownership of cascades.
+     */
+    RegionPool(const vector<CascadeBackend*>& cascades)
+        : mCascades(cascades), mGeneration(0), mActive(0), mStop(false), mNext(0), mPyramid(0), mGray(0), mRegions(0),
+        mMinSizes(0), mObjects(0) {
+        for (size_t i = 0; i < mCascades.size(); ++i) {
+            mThreads.push_back(thread(&RegionPool::run, this, mCascades[i]));
+        }
+    }
+
+    ~RegionPool() {
+        {
+            lock_guard<mutex> lock(mMutex);
+            mStop = true;
+        }
+        mWake.notify_all();
+        for (size_t i = 0; i < mThreads.size(); ++i) {
+            mThreads[i].join();
+        }
+        for (size_t i = 0; i < mCascades.size(); ++i) {
+            delete mCascades[i];
+        }
+    }
+
+    /**
+     * Finds objects in every region, the calling thread uses \a cascade.
+     * @param Found objects per region
+     * @param Minimum object size per region, \a minSize is used for all if 0
+     */
+    void find(CascadeBackend* cascade, haar::Pyramid* pyramid, const Mat& gray, const vector<Rect>& regions, Size minSize,
+        vector<vector<Rect> >& objects, const vector<Size>* minSizes = 0) {
+        // Grows only, so vectors keep their memory for the next image.
+        if (objects.size() < regions.size()) {
+            objects.resize(regions.size());
+        }
+        {
+            lock_guard<mutex> lock(mMutex);
+            mPyramid = pyramid;
+            mGray = &gray;
+            mMinSize = minSize;
+            mMinSizes = minSizes;
+            mRegions = &regions;
+            mObjects = &objects;
+            mNext = 0;
+            mActive = mThreads.size();
+            ++mGeneration;
+        }
+        mWake.notify_all();
+
+        work(cascade);
+
+        unique_lock<mutex> lock(mMutex);
+        mDone.wait(lock, [this] { return mActive == 0; });
+    }
+
+private:
+
+    void run(CascadeBackend* cascade) {
+        size_t seen = 0;
+        for (;;) {
+            {
+                unique_lock<mutex> lock(mMutex);
+                mWake.wait(lock, [this, seen] { return mStop || mGeneration != seen; });
+                if (mStop) {
+                    return;
+                }
+                seen = mGeneration;
+            }
+
+            work(cascade);
+
+            lock_guard<mutex> lock(mMutex);
+            if (--mActive == 0) {
+                mDone.notify_one();
+            }
+        }
+    }
+
+    /**
+     * Takes regions one by one until none is left.
+     */
+    void work(CascadeBackend* cascade) {
+        for (size_t i = mNext++; i < mRegions->size(); i = mNext++) {
+            findIn(cascade, mPyramid, *mGray, (*mRegions)[i], mMinSizes ? (*mMinSizes)[i] : mMinSize, (*mObjects)[i]);
+        }
+    }
+
+    vector<CascadeBackend*> mCascades;
+    vector<thread> mThreads;
+    mutex mMutex;
+    condition_variable mWake;
+    condition_variable mDone;
+
+    /**
+     * Incremented for every image so workers wake up once per image.
+     */
+    size_t mGeneration;
+
+    /**
+     * Workers that did not finish the current image.
+     */
+    size_t mActive;
+    bool mStop;
+
+    /**
+     * Next region to take.
+     */
+    atomic<size_t> mNext;
+
+    /**
+     * Current image.
+     */
+    haar::Pyramid* mPyramid;
+    const Mat* mGray;
+    const vector<Rect>* mRegions;
+    Size mMinSize;
+    const vector<Size>* mMinSizes;
+    vector<vector<Rect> >* mObjects;
+};
+
+/**
+ * Handler to detect faces and eyes.
+ */
+class Detector {
+public:
+
+    /**
+     * @params Classifiers
+     */
+    Detector(CascadeBackend* faceCascade, CascadeBackend* eyesCascade)
+        : mFaceCascade(faceCascade), mEyesCascade(eyesCascade), mMinFace(0), mWorkSize(0), mRefine(false), mTileSize(0),
+        mMaxFace(0), mDeadline(0), mEyeBand(1) {}
+    ~Detector() {
+        delete mFaceCascade;
+        delete mEyesCascade;
+    }
+
+    /**
+     * Looks for eyes of different faces in parallel.
+     * @param Pool with more eye cascades, ownership is taken.
+     */
+    void setEyePool(RegionPool* pool) {
+        mEyePool.reset(pool);
+    }
+
+    /**
+     * Detects faces of different tiles in parallel.
+     * @param Pool with more face cascades, ownership is taken.
+     */
+    void setTilePool(RegionPool* pool) {
+        mTilePool.reset(pool);
+    }
+
+    /**
+     * Splits big images into overlapping tiles, so integrals stay small and tiles can be detected in parallel.
+     * @param Images with a side longer than this many pixels are split into tiles of this size, 0 to not split
+     * @param Maximum face size in pixels of original images, tiles overlap by it so every face is entirely in one of them.
+     * At most half of the tile size, 0 for a quarter of it.
+     */
+    void setTiling(int tileSize, int maxFace) {
+        mTileSize = tileSize;
+        mMaxFace = maxFace;
+    }
+
+    /**
+     * Relaxes settings of detection, chosen per image from QUALITY_LADDER by a cost model learned from previous images,
+     * so detection is predicted to take less than the deadline.
+     * @param Milliseconds per image, 0 to always detect with the best settings
+     */
+    void setDeadline(double millis) {
+        mDeadline = millis;
+    }
+
+    double deadline() const {
+        return mDeadline;
+    }
+
+    /**
+     * Searches eyes only in an upper band of every face, with the minimum eye size scaled to the face.
+     * @param Part of the face height from its top, 1 to search the whole face for eyes of the fixed minimum size
+     */
+    void setEyeBand(double band) {
+        mEyeBand = band;
+    }
+
+    /**
+     * Memory reused by processing of images in the thread of the detector.
+     */
+    Scratch& scratch() {
+        return mScratch;
+    }
+
+    /**
+     * Detects on a downscaled image, so faces smaller than \a minFace are not searched for.
+     * @param Minimum face size in pixels of original images, 0 to detect on full resolution
+     * @param Images are not downscaled to a longer side smaller than this, 0 for no limit
+     * @param If faces found are detected again on full resolution crops
+     */
+    void setDownscale(int minFace, int workSize, bool refine) {
+        mMinFace = minFace;
+        mWorkSize = workSize;
+        mRefine = refine;
+    }
+
+    /**
+     * @return How much an image of the size is downscaled for detection, 1 if not.
+     */
+    double downscale(Size size) const {
+        if (mMinFace <= MIN_SIZE) {
+            return 1;
+        }
+
+        // Faces of the minimum size become as small as the detector looks for.
+        double factor = double(mMinFace) / MIN_SIZE;
+        if (mWorkSize > 0) {
+            factor = min(factor, double(max(size.width, size.height)) / mWorkSize);
+        }
+
+        return max(1., factor);
+    }
+
+    /**
+     * @return true If faces found on a downscaled image are detected again on full resolution crops.
+     */
+    bool refines() const {
+        return mRefine;
+    }
+
+    /**
+     * Detects faces and eyes based on provided cascades.
+     * @param Image
+     * @param Output filename to store result image. If not provided will show a dialog.
+     * @return true If found.
+     */
+    bool detect(Mat& image, const string& output) {
+        Detection detection;
+        find(image, detection);
+
+        return save(image, detection, output);
+    }
+
+    /**
+     * Detects faces and eyes without touching the image.
+     * @return true If found.
+     */
+    bool find(const Mat& image, Detection& detection) {
+        const uchar* before = mGray.data;
+        equalizedGray(image, mGray);
+        if (mGray.data != before) {
+            ++mScratch.reallocations;
+        }
+
+        return findEqualized(mGray, 1, detection);
+    }
+
+    /**
+     * Detects faces and eyes on a grayscale image that the decoder may have reduced already.
+     * @param Grayscale image, equalized in place
+     * @param The image is that many times smaller than the original one, results are scaled back by it
+     * @return true If found.
+     */
+    bool findGray(Mat& gray, int reduced, Detection& detection) {
+        equalizeHist(gray, gray);
+
+        bool result = findEqualized(gray, reduced, detection);
+        if (reduced > 1) {
+            for (size_t i = 0; i < detection.faces.size(); ++i) {
+                detection.faces[i] = scale(detection.faces[i], reduced);
+            }
+            for (size_t i = 0; i < detection.eyes.size(); ++i) {
+                detection.eyes[i] = scale(detection.eyes[i], reduced);
+            }
+        }
+
+        return result;
+    }
+
+    /**
+     * Equalized grayscale of the image passed to find() last.
+     */
+    const Mat& gray() const {
+        return mGray;
+    }
+
+    /**
+     * Draws rectangle around each face and eye.
+     */
+    static void annotate(Mat& image, const Detection& detection) {
+        draw(image, detection.faces);
+        draw(image, detection.eyes);
+    }
+
+    /**
+     * Draws rectangle around each face and eye and stores the image.
+     * @param Image
+     * @param Found faces and eyes
+     * @param Output filename to store result image. If not provided will show a dialog.
+     * @return true If found and stored.
+     */
+    static bool save(Mat& image, const Detection& detection, const string& output) {
+        bool result = !detection.faces.empty();
+        annotate(image, detection);
+        if (output.empty()) {
+            imshow("Facedetect", image);
+            waitKey(0);
+            return result;
+        }
+
+        return result && imwrite(output, image);
+    }
+
+    /**
+     * Minimum size of faces and eyes searched for in the image the cascades run on.
+     */
+    static const int MIN_SIZE = 30;
+
+private:
+
+    static Rect scale(const Rect& r, double factor) {
+        return Rect(cvRound(r.x * factor), cvRound(r.y * factor), cvRound(r.width * factor), cvRound(r.height * factor));
+    }
+
+    /**
+     * Detects faces and eyes on the image, that is \a reduced times smaller than the original one.
+     * Results are in coordinates of the image.
+     */
+    bool findEqualized(const Mat& gray, int reduced, Detection& detection) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        std::vector<Rect>& faces = detection.faces;
+        detection.eyes.clear();
+
+        // What is left to downscale after the decoder.
+        double factor = max(1., downscale(Size(gray.cols * reduced, gray.rows * reduced)) / reduced);
+        Mat work = gray;
+        if (factor > 1) {
+            resize(gray, mSmall, Size(cvRound(gray.cols / factor), cvRound(gray.rows / factor)), 0, 0, INTER_AREA);
+            work = mSmall;
+        }
+
+        const Quality& quality = detection.quality;
+        detection.quality = QUALITY_LADDER[0];
+        detection.predicted = 0;
+        bool tiled = tiles(work.size());
+        if (mDeadline > 0) {
+            detection.quality = QUALITY_LADDER[mCost.choose(work.size(), mDeadline, tiled)];
+            detection.predicted = mCost.predict(work.size(), quality, tiled);
+        }
+
+        // Built-in backends share levels of the frame between faces and eyes of every face.
+        // Levels of tiled images are not built at all, eyes are searched on crops.
+        mPyramid.reset(work, quality.scaleFactor);
+        haar::Pyramid* pyramid = &mPyramid;
+        Size minSize(quality.minSize, quality.minSize);
+        if (findTiled(work, factor, faces)) {
+            pyramid = 0;
+        } else if (!mFaceCascade->detectMultiScale(mPyramid, Rect(0, 0, work.cols, work.rows), faces, 2, minSize)) {
+            mFaceCascade->detectMultiScale(work, faces, quality.scaleFactor, 2, minSize);
+        }
+        chrono::steady_clock::time_point found = chrono::steady_clock::now();
+
+        // Eyes are searched on the image faces are found on, the downscaled one unless faces are refined.
+        const Mat* eyesImage = &gray;
+        const vector<Rect>* eyesFaces = &faces;
+        double eyesFactor = 1;
+        if (factor > 1) {
+            // Back to the original image.
+            vector<Rect>& small = mSmallFaces;
+            small.assign(faces.begin(), faces.end());
+            for (size_t i = 0; i < faces.size(); ++i) {
+                faces[i] = scale(faces[i], factor) & Rect(0, 0, gray.cols, gray.rows);
+            }
+            if (mRefine) {
+                for (size_t i = 0; i < faces.size(); ++i) {
+                    refine(gray, faces[i]);
+                }
+                pyramid = 0;
+            } else {
+                eyesImage = &work;
+                eyesFaces = &small;
+                eyesFactor = factor;
+            }
+        }
+
+        chrono::steady_clock::time_point refined = chrono::steady_clock::now();
+        if (quality.eyes) {
+            findEyes(*eyesImage, pyramid, *eyesFaces, eyesFactor, detection.eyes);
+        }
+        if (mDeadline > 0) {
+            chrono::steady_clock::time_point end = chrono::steady_clock::now();
+            mCost.learnFaces(work.size(), quality, chrono::duration<double, milli>(found - start).count(), tiled);
+            if (factor > 1 && mRefine) {
+                mCost.learnRefine(faces.size(), chrono::duration<double, milli>(refined - found).count());
+            }
+            mCost.learnEyes(quality, faces.size(), chrono::duration<double, milli>(end - refined).count());
+            detection.elapsed = chrono::duration<double, milli>(end - start).count();
+        }
+
+        return !faces.empty();
+    }
+
+    /**
+     * @return true If an image of the size the cascade runs on is split into tiles.
+     */
+    bool tiles(Size size) const {
+        return mTileSize > 0 && (size.width > mTileSize || size.height > mTileSize);
+    }
+
+    /**
+     * Detects faces by overlapping tiles if the image is bigger than a tile.
+     * @param Image the cascade runs on
+     * @param The image is that many times smaller than the original one
+     * @param Found faces
+     * @return false If the image is not split.
+     */
+    bool findTiled(const Mat& gray, double factor, vector<Rect>& faces) {
+        if (!tiles(gray.size())) {
+            return false;
+        }
+
+        // Tiles overlap by the maximum face. Options keep it within half of a tile, the cap only keeps the stride positive.
+        int maxFace = mMaxFace > 0 ? cvRound(mMaxFace / factor) : mTileSize / 4;
+        int overlap = min(mTileSize / 2, max(MIN_SIZE, maxFace));
+        int stride = mTileSize - overlap;
+        Rect whole(0, 0, gray.cols, gray.rows);
+        mTiles.clear();
+        for (int y = 0; ; y += stride) {
+            int top = min(y, max(0, gray.rows - mTileSize));
+            for (int x = 0; ; x += stride) {
+                int left = min(x, max(0, gray.cols - mTileSize));
+                mTiles.push_back(Rect(left, top, mTileSize, mTileSize) & whole);
+                if (left + mTileSize >= gray.cols) {
+                    break;
+                }
+            }
+            if (top + mTileSize >= gray.rows) {
+                break;
+            }
+        }
+
+        Size minSize(MIN_SIZE, MIN_SIZE);
+        if (mTilePool) {
+            mTilePool->find(mFaceCascade, 0, gray, mTiles, minSize, mTileFaces);
+        } else {
+            if (mTileFaces.size() < mTiles.size()) {
+                mTileFaces.resize(mTiles.size());
+            }
+            for (size_t i = 0; i < mTiles.size(); ++i) {
+                findIn(mFaceCascade, 0, gray, mTiles[i], minSize, mTileFaces[i]);
+            }
+        }
+
+        // A face cut by a seam overlaps the entire one found in the neighbor tile, the one farther from seams is kept.
+        faces.clear();
+        mClearance.clear();
+        for (size_t i = 0; i < mTiles.size(); ++i) {
+            for (size_t j = 0; j < mTileFaces[i].size(); ++j) {
+                const Rect& face = mTileFaces[i][j];
+                int clearance = seamDistance(face, mTiles[i], whole);
+                size_t k = 0;
+                for (; k < faces.size(); ++k) {
+                    if ((face & faces[k]).area() * 2 > min(face.area(), faces[k].area())) {
+                        break;
+                    }
+                }
+                if (k == faces.size()) {
+                    faces.push_back(face);
+                    mClearance.push_back(clearance);
+                } else if (clearance > mClearance[k]) {
+                    faces[k] = face;
+                    mClearance[k] = clearance;
+                }
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * @return Distance from the face to the closest edge of the tile that is not an edge of the image.
+     */
+    static int seamDistance(const Rect& face, const Rect& tile, const Rect& image) {
+        int result = numeric_limits<int>::max();
+        if (tile.x > image.x) {
+            result = min(result, face.x - tile.x);
+        }
+        if (tile.y > image.y) {
+            result = min(result, face.y - tile.y);
+        }
+        if (tile.x + tile.width < image.x + image.width) {
+            result = min(result, tile.x + tile.width - face.x - face.width);
+        }
+        if (tile.y + tile.height < image.y + image.height) {
+            result = min(result, tile.y + tile.height - face.y - face.height);
+        }
+
+        return result;
+    }
+
+    /**
+     * Finds eyes of every face.
+     * @param Image faces are in
+     * @param Pyramid of the image, if there is
+     * @param Faces in the image
+     * @param Found eyes are scaled by this factor
+     * @param Found eyes
+     */
+    void findEyes(const Mat& gray, haar::Pyramid* pyramid, const vector<Rect>& faces, double factor, vector<Rect>& result) {
+        Size minSize(max(1, cvRound(MIN_SIZE / factor)), max(1, cvRound(MIN_SIZE / factor)));
+        const vector<Rect>* regions = &faces;
+        const vector<Size>* minSizes = 0;
+        if (mEyeBand < 1) {
+            mEyeBands.clear();
+            mEyeSizes.clear();
+            for (size_t i = 0; i < faces.size(); ++i) {
+                mEyeBands.push_back(eyeBand(faces[i], mEyeBand));
+                mEyeSizes.push_back(eyeMinSize(faces[i], minSize.width));
+            }
+            regions = &mEyeBands;
+            minSizes = &mEyeSizes;
+        }
+
+        if (mEyePool && faces.size() > 1) {
+            // Merged in the order of faces, so results do not depend on scheduling.
+            mEyePool->find(mEyesCascade, pyramid, gray, *regions, minSize, mEyes, minSizes);
+        } else {
+            if (mEyes.size() < faces.size()) {
+                mEyes.resize(faces.size());
+            }
+            for (size_t i = 0; i < faces.size(); ++i) {
+                findIn(mEyesCascade, pyramid, gray, (*regions)[i], minSizes ? (*minSizes)[i] : minSize, mEyes[i]);
+            }
+        }
+
+        for (size_t i = 0; i < faces.size(); ++i) {
+            for (size_t j = 0; j < mEyes[i].size(); ++j) {
+                result.push_back(factor == 1 ? mEyes[i][j] : scale(mEyes[i][j], factor));
+            }
+        }
+    }
+
+    /**
+     * Detects the face again on a full resolution crop around it, keeps it if not found.
+     */
+    void refine(const Mat& gray, Rect& face) {
+        Rect crop(face.x - face.width / 4, face.y - face.height / 4, face.width * 3 / 2, face.height * 3 / 2);
+        crop &= Rect(0, 0, gray.cols, gray.rows);
+        vector<Rect>& found = mRefined;
+        mFaceCascade->detectMultiScale(gray(crop), found, 1.1, 2, Size(face.width * 4 / 5, face.height * 4 / 5));
+
+        // The one that overlaps the most.
+        Rect initial = face;
+        int best = 0;
+        for (size_t i = 0; i < found.size(); ++i) {
+            Rect r = found[i] + crop.tl();
+            int overlap = (r & initial).area();
+            if (overlap > best) {
+                best = overlap;
+                face = r;
+            }
+        }
+    }
+
+    /**
+     * Draws rectangles.
+     */
+    static void draw(Mat& image, const vector<Rect>& rects) {
+        for (size_t i = 0; i < rects.size(); ++i) {
+            Point pt1(rects[i].x, rects[i].y);
+            Point pt2((rects[i].x + rects[i].height), (rects[i].y + rects[i].width));
+            rectangle(image, pt1, pt2, Scalar(0, 255, 0), 2, 8, 0);
+        }
+    }
+
+    /**
+     * Classifiers
+     */
+    CascadeBackend* mFaceCascade;
+    CascadeBackend* mEyesCascade;
+
+    /**
+     * Levels of the current image.
+     */
+    haar::Pyramid mPyramid;
+
+    unique_ptr<RegionPool> mEyePool;
+
+    /**
+     * Eyes per face.
+     */
+    vector<vector<Rect> > mEyes;
+
+    /**
+     * Downscaling, see setDownscale().
+     */
+    int mMinFace;
+    int mWorkSize;
+    bool mRefine;
+    Mat mSmall;
+
+    /**
+     * Equalized grayscale of the current image, kept to reuse the buffer.
+     */
+    Mat mGray;
+
+    /**
+     * Faces on the downscaled image.
+     */
+    vector<Rect> mSmallFaces;
+
+    /**
+     * Faces found on a crop by refine().
+     */
+    vector<Rect> mRefined;
+
+    /**
+     * Tiling, see setTiling().
+     */
+    unique_ptr<RegionPool> mTilePool;
+    int mTileSize;
+    int mMaxFace;
+    vector<Rect> mTiles;
+
+    /**
+     * Faces per tile and distances of merged faces to seams.
+     */
+    vector<vector<Rect> > mTileFaces;
+    vector<int> mClearance;
+
+    /**
+     * Deadline, see setDeadline(), and what detection takes.
+     */
+    double mDeadline;
+    CostModel mCost;
+
+    /**
+     * Eye band, see setEyeBand(), and regions with minimum eye sizes of the current image.
+     */
+    double mEyeBand;
+    vector<Rect> mEyeBands;
+    vector<Size> mEyeSizes;
+
+    Scratch mScratch;
+};
+
+// Defined, so MIN_SIZE can be passed by reference, e.g. to max().
+const int Detector::MIN_SIZE;
+
+/**
+ * Factory to create a pool of threads that work together with the detector's thread.
+ * @param Cascade filename
+ * @param Number of threads including the detector's one
+ * @return 0 If could not load.
+ */
+RegionPool* createPool(const char* filename, Backend backend, unsigned threads) {
+    vector<CascadeBackend*> cascades;
+    for (unsigned i = 1; i < threads; ++i) {
+        CascadeBackend* cascade = createCascade(filename, backend);
+        if (cascade == 0) {
+            for (size_t j = 0; j < cascades.size(); ++j) {
+                delete cascades[j];
+            }
+            return 0;
+        }
+        cascades.push_back(cascade);
+    }
+
+    return new RegionPool(cascades);
+}
+
+/**
+ * Factory to create a detector.
+ * @return 0 If something bad occured.
+ */
+Detector* createDetector(const char* faceCascadeFilename, const char* eyesCascadeFilename, Backend backend = BACKEND_AUTO,
+    unsigned eyeThreads = 1, unsigned tileThreads = 1) {
+    CascadeBackend* faceCascade = createCascade(faceCascadeFilename, backend);
+    CascadeBackend* eyesCascade = createCascade(eyesCascadeFilename, backend);
+    if (faceCascade == 0 || eyesCascade == 0) {
+        delete faceCascade;
+        delete eyesCascade;
+
+        return 0;
+    }
+
+    Detector* detector = new Detector(faceCascade, eyesCascade);
+    if (eyeThreads > 1) {
+        RegionPool* pool = createPool(eyesCascadeFilename, backend, eyeThreads);
+        if (pool == 0) {
+            delete detector;
+            return 0;
+        }
+        detector->setEyePool(pool);
+    }
+    if (tileThreads > 1) {
+        RegionPool* pool = createPool(faceCascadeFilename, backend, tileThreads);
+        if (pool == 0) {
+            delete detector;
+            return 0;
+        }
+        detector->setTilePool(pool);
+    }
+
+    return detector;
+}
+
+/**
+ * Image to process.
+ */
+struct Job {
+    /**
+     * Path to image.
+     */
+    string path;
+
+    /**
+     * Output filename to store the result.
+     */
+    string output;
+};
+
+/**
+ * What the result cache knows about the file of a job.
+ */
+struct Cached {
+    /**
+     * True if results are taken from the cache.
+     */
+    bool known;
+
+    /**
+     * True if the file could be stat'ed, so results can be stored.
+     */
+    bool valid;
+
+    struct stat st;
+
+    /**
+     * Content hash if it was computed.
+     */
+    uint64_t hash;
+};
+
+/**
+ * Looks for results of the job in the cache.
+ * @param Cache or 0
+ * @param Job
+ * @param Found faces and eyes if known
+ * @param State of the lookup to pass to remember()
+ * @return true If results are known and the output is up to date, so nothing else has to be done.
+ */
+bool lookup(ResultCache* cache, const Job& job, Detection& detection, Cached& cached) {
+    cached.known = false;
+    cached.valid = cache && stat(job.path.c_str(), &cached.st) == 0;
+    cached.hash = 0;
+    if (!cached.valid) {
+        return false;
+    }
+
+    cached.known = cache->lookup(job.path, cached.st, detection.faces, detection.eyes, cached.hash);
+    if (!cached.known) {
+        return false;
+    }
+
+    // Without faces nothing is written, otherwise the output must be newer than the image.
+    struct stat out;
+    return detection.faces.empty() ||
+        (!job.output.empty() && stat(job.output.c_str(), &out) == 0 && out.st_mtime >= cached.st.st_mtime);
+}
+
+/**
+ * Stores just found results of the job in the cache.
+ */
+void remember(ResultCache* cache, const Job& job, const Detection& detection, const Cached& cached) {
+    if (cached.valid && !cached.known) {
+        cache->store(job.path, cached.st, detection.faces, detection.eyes, cached.hash);
+    }
+}
+
+/**
+ * Decodes the image of the job for detection.
+ * If the detector downscales and results are stored to files, a grayscale image reduced by the decoder
+ * is enough: colors are decoded by decodeColor() only if faces are found.
+ * @param Detector the image is for
+ * @param Job
+ * @param If only records are written, colors are never needed then
+ * @param Decoded image
+ * @param How many times the image is reduced
+ * @param Buffer to decode full size images into or 0, the image is valid until the buffer is used again
+ * @return false If could not decode.
+ */
+bool decode(const Detector& detector, const Job& job, bool recordsOnly, imgio::Image& input, int& reduced,
+    imgio::PixelBuffer* buffer = 0) {
+    reduced = 1;
+    int flags = recordsOnly ? CV_LOAD_IMAGE_GRAYSCALE : CV_LOAD_IMAGE_COLOR;
+    if (recordsOnly || !job.output.empty() || buffer) {
+        imgio::MappedFile file;
+        Size size;
+        if (file.open(job.path) && imgio::probe(file.data(), file.size(), size)) {
+            input = imgio::Image();
+            // Refining needs full resolution crops, so the decoder must not reduce then.
+            if ((recordsOnly || !job.output.empty()) && !detector.refines()) {
+                reduced = imgio::reduction(detector.downscale(size));
+            }
+            if (reduced > 1) {
+                input.pixels = imgio::decodeReduced(file.data(), file.size(), reduced);
+                return !input.pixels.empty();
+            }
+            if (buffer) {
+                return imgio::decodeInto(file.data(), file.size(), size, flags, *buffer, input.pixels);
+            }
+        }
+    }
+
+    return imgio::open(job.path, input, flags);
+}
+
+/**
+ * Detects faces and eyes on the image decoded by decode().
+ */
+bool find(Detector& detector, imgio::Image& input, int reduced, Detection& detection) {
+    return input.pixels.channels() == 1 ? detector.findGray(input.pixels, reduced, detection) :
+        detector.find(input.pixels, detection);
+}
+
+/**
+ * Writes results of the job as a record if records are written.
+ * @return false If records are not written.
+ */
+bool record(RecordWriter* records, const Job& job, const Detection& detection) {
+    if (!records) {
+        return false;
+    }
+
+    if (!records->write(job.path, detection.faces, detection.eyes)) {
+        cerr << "Could not write record of " << job.path << endl;
+    }
+    return true;
+}
+
+/**
+ * Prints settings detection of the job used if it has a deadline.
+ */
+void reportQuality(const Detector& detector, const Job& job, const Detection& detection) {
+    if (detector.deadline() <= 0) {
+        return;
+    }
+
+    // One write per line, so lines of different threads do not mix.
+    ostringstream line;
+    line << job.path << ": scale factor " << detection.quality.scaleFactor << ", min size " <<
+        detection.quality.minSize << ", eyes " << (detection.quality.eyes ? "on" : "off") << ", " <<
+        detection.predicted << " ms predicted, " << detection.elapsed << " ms taken" <<
+        (detection.elapsed > detector.deadline() ? ", late" : "") << "\n";
+    cerr << line.str();
+}
+
+/**
+ * Decodes colors of the image if decode() produced a reduced grayscale one.
+ * @return false If could not decode.
+ */
+bool decodeColor(const Job& job, imgio::Image& input, int& reduced) {
+    if (reduced == 1) {
+        return true;
+    }
+
+    reduced = 1;
+    return imgio::open(job.path, input, CV_LOAD_IMAGE_COLOR);
+}
+
+/**
+ * Detects faces in the image of the job using memory of the detector.
+ * @return true If found a face.
+ */
+bool processImage(Detector& detector, const Job& job, ResultCache* cache, RecordWriter* records) {
+    Scratch& scratch = detector.scratch();
+    Detection& detection = scratch.detection;
+    detection.faces.clear();
+    detection.eyes.clear();
+    Cached cached;
+    bool done = lookup(cache, job, detection, cached);
+    if (done || (records && cached.known)) {
+        record(records, job, detection);
+        return !detection.faces.empty();
+    }
+
+    imgio::Image& input = scratch.input;
+    int reduced = 1;
+    bool result = false;
+    bool loaded = cached.known ? imgio::open(job.path, input, CV_LOAD_IMAGE_COLOR) :
+        decode(detector, job, records != 0, input, reduced, &scratch.pixels);
+    if (loaded) {
+        try {
+            if (!cached.known) {
+                find(detector, input, reduced, detection);
+                remember(cache, job, detection, cached);
+                reportQuality(detector, job, detection);
+            }
+            if (record(records, job, detection)) {
+                return !detection.faces.empty();
+            }
+            // Nothing is stored without faces, so colors are not needed then.
+            if ((detection.faces.empty() && !job.output.empty()) || !decodeColor(job, input, reduced)) {
+                return false;
+            }
+            result = Detector::save(input.pixels, detection, job.output);
+        } catch (Exception& e) {
+            cerr << e.what() << endl;
+        }
+    }
+    return result;
+}
+
+/**
+ * Detects faces in the image of the job and counts allocations it took if built to count them.
+ * @param Detector
+ * @param Job
+ * @param Cache of results or 0
+ * @param Writer of records or 0 to store annotated images
+ * @return true If found a face.
+ */
+bool process(Detector& detector, const Job& job, ResultCache* cache, RecordWriter* records) {
+    Scratch& scratch = detector.scratch();
+    ++scratch.images;
+#ifdef FD_COUNT_ALLOCATIONS
+    size_t before = allocations;
+    bool result = processImage(detector, job, cache, records);
+    size_t made = allocations - before;
+    scratch.allocations += made;
+    if (made == 0) {
+        ++scratch.steady;
+    }
+
+    return result;
+#else
+    return processImage(detector, job, cache, records);
+#endif
+}
+
+/**
+ * Receives jobs found by Reader.
+ */
+class Processor {
+public:
+
+    virtual ~Processor() {}
+
+    /**
+     * Processes the job now or later.
+     * @return true If already known that a face is found.
+     */
+    virtual bool push(const Job& job) = 0;
+
+    /**
+     * Waits until all pushed jobs are processed.
+     * @return true If found a face in any of them.
+     */
+    virtual bool finish() = 0;
+
+    /**
+     * Prints counters collected while processing.
+     */
+    virtual void report(ostream& out) const {}
+};
+
+/**
+ * Processes jobs one by one in the calling thread.
+ */
+class SerialProcessor : public Processor {
+public:
+
+    /**
+     * @param Detector. Takes ownership.
+     * @param Cache of results or 0
+     */
+    SerialProcessor(Detector* detector, ResultCache* cache, RecordWriter* records)
+        : mDetector(detector), mCache(cache), mRecords(records) {}
+
+    ~SerialProcessor() {
+        delete mDetector;
+    }
+
+    virtual bool push(const Job& job) {
+        return process(*mDetector, job, mCache, mRecords);
+    }
+
+    virtual bool finish() {
+        return false;
+    }
+
+    virtual void report(ostream& out) const {
+        mDetector->scratch().report(out);
+    }
+
+private:
+
+    Detector* mDetector;
+    ResultCache* mCache;
+    RecordWriter* mRecords;
+};
+
+/**
+ * Processes jobs by a pool of threads.
+ * Every thread owns its detector since classifiers can't be shared between threads.
+ */
+class PoolProcessor : public Processor {
+public:
+
+    /**
+     * @param Detectors, one per thread. Takes ownership.
+     * @param Maximum number of jobs waiting for a thread.
+     * @param Cache of results or 0
+     */
+    PoolProcessor(const vector<Detector*>& detectors, size_t capacity, ResultCache* cache, RecordWriter* records)
+        : mDetectors(detectors), mJobs(max<size_t>(1, capacity)), mFirst(0), mCount(0), mCache(cache), mRecords(records),
+        mDone(false), mResult(false) {
+        for (size_t i = 0; i < mDetectors.size(); ++i) {
+            mThreads.push_back(thread(&PoolProcessor::work, this, mDetectors[i]));
+        }
+    }
+
+    ~PoolProcessor() {
+        finish();
+        for (size_t i = 0; i < mDetectors.size(); ++i) {
+            delete mDetectors[i];
+        }
+    }
+
+    /**
+     * Queues the job, blocks while the queue is full.
+     * The job is copied into a slot whose strings kept their memory from earlier jobs.
+     */
+    virtual bool push(const Job& job) {
+        unique_lock<mutex> lock(mMutex);
+        mNotFull.wait(lock, [this] { return mCount < mJobs.size(); });
+        Job& slot = mJobs[(mFirst + mCount) % mJobs.size()];
+        slot.path.assign(job.path);
+        slot.output.assign(job.output);
+        ++mCount;
+        mNotEmpty.notify_one();
+
+        return false;
+    }
+
+    virtual bool finish() {
+        {
+            lock_guard<mutex> lock(mMutex);
+            mDone = true;
+            mNotEmpty.notify_all();
+        }
+        for (size_t i = 0; i < mThreads.size(); ++i) {
+            if (mThreads[i].joinable()) {
+                mThreads[i].join();
+            }
+        }
+
+        return mResult;
+    }
+
+    virtual void report(ostream& out) const {
+        Scratch total;
+        for (size_t i = 0; i < mDetectors.size(); ++i) {
+            const Scratch& s = mDetectors[i]->scratch();
+            total.images += s.images;
+            total.allocations += s.allocations;
+            total.steady += s.steady;
+            total.reallocations += s.reallocations + s.pixels.growths();
+        }
+        total.report(out);
+    }
+
+private:
+
+    /**
+     * Thread loop.
+     */
+    void work(Detector* detector) {
+        // Strings are swapped with the slot, so both keep their memory for the next jobs.
+        Job job;
+        for (;;) {
+            {
+                unique_lock<mutex> lock(mMutex);
+                mNotEmpty.wait(lock, [this] { return mCount > 0 || mDone; });
+                if (mCount == 0) {
+                    return;
+                }
+                Job& slot = mJobs[mFirst];
+                job.path.swap(slot.path);
+                job.output.swap(slot.output);
+                mFirst = (mFirst + 1) % mJobs.size();
+                --mCount;
+                mNotFull.notify_one();
+            }
+
+            if (process(*detector, job, mCache, mRecords)) {
+                mResult = true;
+            }
+        }
+    }
+
+    vector<Detector*> mDetectors;
+    vector<thread> mThreads;
+
+    /**
+     * Ring of queued jobs, mCount of them from mFirst.
+     */
+    vector<Job> mJobs;
+    size_t mFirst;
+    size_t mCount;
+    ResultCache* mCache;
+    RecordWriter* mRecords;
+    bool mDone;
+    atomic<bool> mResult;
+    mutex mMutex;
+    condition_variable mNotEmpty;
+    condition_variable mNotFull;
+};
+
 /**
- * Handler to detect faces and eyes.
+ * Processes jobs by three stages connected by bounded queues:
+ * reading and decoding, detection, drawing and encoding.
+ * Every stage has its own threads so each can keep its resource busy.
  */
-class Detector {
+class PipelineProcessor : public Processor {
 public:
 
     /**
-     * @params Classifiers
+     * @param Number of decoding threads
+     * @param Detectors, one per detection thread. Takes ownership.
+     * @param Number of encoding threads
+     * @param Capacity of queues in front of decoding, detection and encoding.
+     * @param Cache of results or 0
+     * @param Writer of records or 0 to store annotated images, encoders stay idle with it.
      */
-    Detector(CascadeClassifier* faceCascade,
-        CascadeClassifier* eyesCascade) : mFaceCascade(faceCascade), mEyesCascade(eyesCascade) {}
-    ~Detector() {
-        delete mFaceCascade;
-        delete mEyesCascade;
+    PipelineProcessor(unsigned decoders, const vector<Detector*>& detectors, unsigned encoders, const size_t depth[3],
+        ResultCache* cache, RecordWriter* records)
+        : mDetectors(detectors), mCache(cache), mRecords(records),
+        mJobs(depth[0], 1), mDecoded(depth[1], decoders), mDetected(depth[2], detectors.size()),
+        mResult(false), mFinished(false) {
+        for (size_t i = 0; i < 3; ++i) {
+            mBusy[i] = 0;
+        }
+        for (unsigned i = 0; i < decoders; ++i) {
+            mThreads.push_back(thread(&PipelineProcessor::decode, this));
+        }
+        for (size_t i = 0; i < mDetectors.size(); ++i) {
+            mThreads.push_back(thread(&PipelineProcessor::detect, this, mDetectors[i]));
+        }
+        for (unsigned i = 0; i < encoders; ++i) {
+            mThreads.push_back(thread(&PipelineProcessor::encode, this));
+        }
     }
 
-    /**
-     * Detects faces and eyes based on provided cascades.
-     * @param Image
-     * @param Output filename to store result image. If not provided will show a dialog.
-     * @return true If found.
-     */
-    bool detect(Mat& image, const string& output) {
-        bool result = false;
-        std::vector<Rect> faces;
-        Mat gray;
+    ~PipelineProcessor() {
+        finish();
+        for (size_t i = 0; i < mDetectors.size(); ++i) {
+            delete mDetectors[i];
+        }
+    }
 
-        cvtColor(image, gray, CV_BGR2GRAY);
-        equalizeHist(gray, gray);
+    virtual bool push(const Job& job) {
+        Frame frame;
+        frame.job = job;
+        mJobs.push(std::move(frame));
 
-        mFaceCascade->detectMultiScale(gray, faces, 1.1, 2, 0|CV_HAAR_SCALE_IMAGE, Size(30, 30));
-        for (size_t i = 0; i < faces.size(); ++i) {
-            result = true;
-            Point pt1(faces[i].x, faces[i].y);
-            Point pt2((faces[i].x + faces[i].height), (faces[i].y + faces[i].width));
-            rectangle(image, pt1, pt2, Scalar(0, 255, 0), 2, 8, 0);
+        return false;
+    }
 
-            Mat faceROI = gray(faces[i]);
-            std::vector<Rect> eyes;
-            mEyesCascade->detectMultiScale(faceROI, eyes, 1.1, 2, 0 |CV_HAAR_SCALE_IMAGE, Size(30, 30));
-            for (size_t j = 0; j < eyes.size(); ++j) {
-                Point pt1(faces[i].x + eyes[j].x, faces[i].y + eyes[j].y);
-                Point pt2((faces[i].x + eyes[j].x + eyes[j].height), (faces[i].y + eyes[j].y + eyes[j].width));
-                rectangle(image, pt1, pt2, Scalar(0, 255, 0), 2, 8, 0);
+    virtual bool finish() {
+        if (!mFinished) {
+            mFinished = true;
+            mJobs.leave();
+            for (size_t i = 0; i < mThreads.size(); ++i) {
+                mThreads[i].join();
             }
         }
-        if (output.empty()) {
-            imshow("Facedetect", image);
-            waitKey(0);
-            return result;
-        }
 
-        return result && imwrite(output, image);
+        return mResult;
+    }
+
+    virtual void report(ostream& out) const {
+        const char* names[3] = {"decode", "detect", "encode"};
+        QueueStats stats[3] = {mJobs.stats(), mDecoded.stats(), mDetected.stats()};
+        size_t capacity[3] = {mJobs.capacity(), mDecoded.capacity(), mDetected.capacity()};
+        for (size_t i = 0; i < 3; ++i) {
+            out << names[i] << ": items " << stats[i].items <<
+                ", busy " << mBusy[i] / 1000000 << " ms" <<
+                ", input occupancy " << stats[i].occupancy << "/" << capacity[i] <<
+                ", input stalls " << stats[i].pushStalls <<
+                ", idle stalls " << stats[i].popStalls << endl;
+        }
     }
 
 private:
 
     /**
-     * Classifiers
+     * Job moving through the stages.
      */
-    CascadeClassifier* mFaceCascade;
-    CascadeClassifier* mEyesCascade;
-};
+    struct Frame {
+        Job job;
+        imgio::Image input;
 
-/**
- * Factory to create a detector.
- * @return 0 If something bad occured.
- */
-Detector* createDetector(const char* faceCascadeFilename, const char* eyesCascadeFilename) {
-    CascadeClassifier* faceCascade = new CascadeClassifier;
-    CascadeClassifier* eyesCascade = new CascadeClassifier;
-    if (!faceCascade->load(faceCascadeFilename) || !eyesCascade->load(eyesCascadeFilename)) {
-        delete faceCascade;
-        delete eyesCascade;
+        /**
+         * See decode().
+         */
+        int reduced;
+        Detection detection;
+        Cached cached;
+    };
 
-        return 0;
+    /**
+     * Index of stages for counters.
+     */
+    enum Stage {
+        DECODE = 0,
+        DETECT,
+        ENCODE
+    };
+
+    /**
+     * Measures time spent by a stage on one item.
+     */
+    class Busy {
+    public:
+        Busy(atomic<long long>& counter) : mCounter(counter), mStart(chrono::steady_clock::now()) {}
+        ~Busy() {
+            mCounter += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - mStart).count();
+        }
+    private:
+        atomic<long long>& mCounter;
+        chrono::steady_clock::time_point mStart;
+    };
+
+    void decode() {
+        Frame frame;
+        while (mJobs.pop(frame)) {
+            bool loaded = false;
+            {
+                Busy busy(mBusy[DECODE]);
+                bool done = lookup(mCache, frame.job, frame.detection, frame.cached);
+                if (done || (mRecords && frame.cached.known)) {
+                    record(mRecords, frame.job, frame.detection);
+                    if (!frame.detection.faces.empty()) {
+                        mResult = true;
+                    }
+                } else if (frame.cached.known) {
+                    frame.reduced = 1;
+                    loaded = imgio::open(frame.job.path, frame.input, CV_LOAD_IMAGE_COLOR);
+                } else {
+                    // Detectors share settings, any of them tells how much to reduce.
+                    loaded = ::decode(*mDetectors[0], frame.job, mRecords != 0, frame.input, frame.reduced);
+                }
+            }
+            if (loaded) {
+                mDecoded.push(std::move(frame));
+            }
+        }
+        mDecoded.leave();
     }
 
-    return new Detector(faceCascade, eyesCascade);
-}
+    void detect(Detector* detector) {
+        Frame frame;
+        while (mDecoded.pop(frame)) {
+            bool found = false;
+            bool failed = false;
+            {
+                Busy busy(mBusy[DETECT]);
+                try {
+                    if (frame.cached.known) {
+                        found = !frame.detection.faces.empty();
+                    } else {
+                        found = find(*detector, frame.input, frame.reduced, frame.detection);
+                        remember(mCache, frame.job, frame.detection, frame.cached);
+                        reportQuality(*detector, frame.job, frame.detection);
+                    }
+                } catch (Exception& e) {
+                    cerr << e.what() << endl;
+                    failed = true;
+                }
+            }
+            if (mRecords) {
+                if (!failed) {
+                    record(mRecords, frame.job, frame.detection);
+                }
+                if (found) {
+                    mResult = true;
+                }
+                continue;
+            }
+            // Nothing to draw or store without faces.
+            if (found) {
+                mDetected.push(std::move(frame));
+            }
+        }
+        mDetected.leave();
+    }
+
+    void encode() {
+        Frame frame;
+        while (mDetected.pop(frame)) {
+            Busy busy(mBusy[ENCODE]);
+            try {
+                if (decodeColor(frame.job, frame.input, frame.reduced) &&
+                    Detector::save(frame.input.pixels, frame.detection, frame.job.output)) {
+                    mResult = true;
+                }
+            } catch (Exception& e) {
+                cerr << e.what() << endl;
+            }
+        }
+    }
+
+    vector<Detector*> mDetectors;
+    ResultCache* mCache;
+    RecordWriter* mRecords;
+    vector<thread> mThreads;
+    BoundedQueue<Frame> mJobs;
+    BoundedQueue<Frame> mDecoded;
+    BoundedQueue<Frame> mDetected;
+    atomic<bool> mResult;
+    bool mFinished;
+
+    /**
+     * Nanoseconds spent by each stage.
+     */
+    atomic<long long> mBusy[3];
+};
 
 /**
  * Handler to process submitted path.
@@ -109,10 +1478,12 @@ class Reader {
 public:
 
     /**
-     * @param Detector
+     * @param Processor of found images
      * @param Output directory or filename to store the result.
+     * @param Number of files to read ahead of processing.
      */
-    Reader(Detector& detector, const string& output) : mDetector(detector), mOutput(output) {
+    Reader(Processor& processor, const string& output, size_t readahead = 0)
+        : mProcessor(processor), mOutput(output), mReadahead(readahead), mFiles(0), mSeconds(0) {
     }
 
     /**
@@ -120,60 +1491,105 @@ public:
      * @return true If found a face.
      */
     bool read(const string& path) {
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        bool result;
         if (is_dir(path)) {
-            return readDir(path);
+            result = readDir(path);
+        } else {
+            Job job = {path, mOutput};
+            result = push(job);
+        }
+        while (!mWindow.empty()) {
+            result = mProcessor.push(mWindow.front()) || result;
+            mWindow.pop_front();
         }
 
-        return detect(path, mOutput);
-    }
+        result = mProcessor.finish() || result;
+        mSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
 
-private:
+        return result;
+    }
 
     /**
-     * Detects faces using path to file.
-     * @param Path to image
-     * @param Output filename to store the result.
+     * Prints throughput of the last read().
      */
-    bool detect(const string& path, const string& output) {
-        Mat image = imread(path.c_str(), CV_LOAD_IMAGE_COLOR);
-        bool result = false;
-        if (image.data) {
-            try {
-                result = mDetector.detect(image, output);
-            } catch (Exception& e) {
-                cerr << e.what() << endl;
+    void report(ostream& out) const {
+        double mib = mPrefetcher.bytes() / (1024. * 1024.);
+        out << "read: " << mFiles << " files in " << mSeconds << " s";
+        if (mSeconds > 0) {
+            out << ", " << mFiles / mSeconds << " files/s";
+        }
+        if (mReadahead > 0) {
+            out << ", prefetched " << mPrefetcher.files() << " files, " << mib << " MiB";
+            if (mSeconds > 0) {
+                out << ", " << mib / mSeconds << " MiB/s";
             }
         }
-        return result;
+        out << endl;
     }
 
+private:
+
     /**
-     * Reads the dir by path.
+     * Reads the dir by path, every image is pushed to the processor as soon as it is found.
+     * Outputs mirror the tree: a file at a relative path under the dir goes to the same relative path
+     * under the output dir, so files of the same name in different subdirectories never collide.
      * @param true If found result.
      */
     bool readDir(const string& path) {
         bool result = false;
-        DIR* dp = opendir(path.c_str());
-        if (dp == 0) {
-            return result;
-        }
+        Walker walker;
 
-        struct dirent *dirp;
-        while (dirp = readdir(dp)) {
-            string name = dirp->d_name;
-            if (name == "." || name == "..") {
-                continue;
+        // Strings keep their memory for the next file.
+        Job job;
+        string made;
+        walker.walk(path, [&](const string& filepath, const char* name) {
+            job.path.assign(filepath);
+            if (!mOutput.empty()) {
+                job.output.assign(mOutput).append(filepath, path.size(), string::npos);
+                size_t dir = job.output.size() - strlen(name) - 1;
+                if (made.compare(0, string::npos, job.output, 0, dir) != 0) {
+                    made.assign(job.output, 0, dir);
+                    makeDirs(made, mOutput.size());
+                }
             }
-            string filepath = path + "/" + name;
-            if (is_dir(filepath)) {
-                result = readDir(filepath);
-            } else {
-                string o = mOutput.empty() ? mOutput : mOutput + "/" + name;
-                result = detect(filepath, o);
+            result = push(job) || result;
+        });
+
+        return result;
+    }
+
+    /**
+     * Creates missing directories of the path after its first \a from characters.
+     */
+    static void makeDirs(const string& path, size_t from) {
+        for (size_t pos = path.find('/', from + 1); ; pos = path.find('/', pos + 1)) {
+            mkdir(path.substr(0, pos).c_str(), 0777);
+            if (pos == string::npos) {
+                break;
             }
         }
+    }
+
+    /**
+     * Passes the job to the processor. With readahead the job waits in a window
+     * while its file is being read by the kernel.
+     * @return true If found result.
+     */
+    bool push(const Job& job) {
+        ++mFiles;
+        if (mReadahead == 0) {
+            return mProcessor.push(job);
+        }
+
+        mPrefetcher.prefetch(job.path);
+        mWindow.push_back(job);
+        if (mWindow.size() <= mReadahead) {
+            return false;
+        }
 
-        closedir(dp);
+        bool result = mProcessor.push(mWindow.front());
+        mWindow.pop_front();
         return result;
     }
 
@@ -188,49 +1604,581 @@ private:
     }
 
     /**
-     * Detector injection.
+     * Where found images go.
      */
-    Detector& mDetector;
+    Processor& mProcessor;
 
     /**
      * Output finename or dirname to store result.
      */
     const string& mOutput;
+
+    /**
+     * Jobs whose files are being prefetched.
+     */
+    size_t mReadahead;
+    deque<Job> mWindow;
+    Prefetcher mPrefetcher;
+
+    /**
+     * Number of files found and duration of the last read().
+     */
+    size_t mFiles;
+    double mSeconds;
+};
+
+/**
+ * Detects faces in a video file or camera stream.
+ * The cascade runs on keyframes only, faces are tracked between them by Tracker.
+ * With motion gating keyframes are searched only where the scene changed, and nothing is done for still frames.
+ */
+class VideoStream {
+public:
+
+    /**
+     * @param Detector
+     * @param Minimum and maximum number of frames between keyframes
+     * @param If faces are searched only in regions that moved
+     */
+    VideoStream(Detector& detector, int minInterval, int maxInterval, bool gated)
+        : mDetector(detector), mTracker(minInterval, maxInterval), mGated(gated), mFrames(0), mKeyframes(0),
+        mStill(0), mScanned(0), mSeconds(0) {}
+
+    /**
+     * @param Video file, URL or camera index
+     * @param Output video with annotated frames. If not provided and no records will show frames in a dialog.
+     * @param Records written per frame instead of annotated frames or 0
+     * @return false If could not open.
+     */
+    bool run(const string& source, const string& output, RecordWriter* records) {
+        VideoCapture capture;
+        bool camera = !source.empty() && source.find_first_not_of("0123456789") == string::npos;
+        if (!(camera ? capture.open(atoi(source.c_str())) : capture.open(source))) {
+            return false;
+        }
+
+        VideoWriter writer;
+        Mat frame;
+        Mat gray;
+        Detection detection;
+        chrono::steady_clock::time_point start = chrono::steady_clock::now();
+        while (capture.read(frame) && !frame.empty()) {
+            chrono::steady_clock::time_point grabbed = chrono::steady_clock::now();
+            const vector<Rect>* regions = mGated ? &mMotion.update(frame, MOTION_PAD) : 0;
+            if (regions && regions->empty()) {
+                // Nothing moved, faces stay where they are.
+                ++mStill;
+            } else if (mTracker.keyframe()) {
+                if (regions && mMotion.activity() < FULL_FRAME) {
+                    mScanned += findMoving(frame, *regions, detection);
+                    equalizedGray(frame, gray);
+                    mTracker.reset(gray, detection.faces, detection.eyes);
+                } else {
+                    mDetector.find(frame, detection);
+                    mTracker.reset(mDetector.gray(), detection.faces, detection.eyes);
+                    mScanned += 1;
+                }
+                ++mKeyframes;
+            } else {
+                equalizedGray(frame, gray);
+                mTracker.track(gray, detection.faces, detection.eyes);
+            }
+            mLatencies.push_back(chrono::duration<double, milli>(chrono::steady_clock::now() - grabbed).count());
+
+            if (records) {
+                // Frames are named by their number in the stream.
+                string name = source + "#" + to_string(mFrames);
+                if (!records->write(name, detection.faces, detection.eyes)) {
+                    cerr << "Could not write record of " << name << endl;
+                }
+            } else {
+                Detector::annotate(frame, detection);
+                if (output.empty()) {
+                    imshow("Facedetect", frame);
+                    if (waitKey(1) == 27) {
+                        break;
+                    }
+                } else {
+                    if (!writer.isOpened()) {
+                        double fps = capture.get(CV_CAP_PROP_FPS);
+                        if (!writer.open(output, CV_FOURCC('M', 'J', 'P', 'G'), fps > 0 ? fps : 25, frame.size())) {
+                            return false;
+                        }
+                    }
+                    writer.write(frame);
+                }
+            }
+            ++mFrames;
+        }
+        mSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+
+        return true;
+    }
+
+    /**
+     * Prints sustained frame rate and latency from grabbing a frame to having its faces.
+     */
+    void report(ostream& out) {
+        out << "video: " << mFrames << " frames, " << mKeyframes << " keyframes, " <<
+            (mSeconds > 0 ? mFrames / mSeconds : 0) << " fps, keyframe interval " << mTracker.interval() << endl;
+        if (mGated) {
+            out << "motion: " << mStill << " still frames, " << (mKeyframes ? 100 * mScanned / mKeyframes : 0) <<
+                "% of keyframe area searched" << endl;
+        }
+        if (mLatencies.empty()) {
+            return;
+        }
+
+        double total = 0;
+        for (size_t i = 0; i < mLatencies.size(); ++i) {
+            total += mLatencies[i];
+        }
+        sort(mLatencies.begin(), mLatencies.end());
+        out << "latency: " << total / mLatencies.size() << " ms average, " <<
+            mLatencies[mLatencies.size() / 2] << " ms median, " <<
+            mLatencies[mLatencies.size() * 99 / 100] << " ms 99th percentile, " <<
+            mLatencies.back() << " ms max" << endl;
+    }
+
+private:
+
+    /**
+     * Pixels added around motion, so a face that moved only partly is searched entirely.
+     */
+    static const int MOTION_PAD = 32;
+
+    /**
+     * When motion covers that part of a frame, it is searched entirely.
+     */
+    static constexpr double FULL_FRAME = 0.5;
+
+    /**
+     * Searches faces in moving regions and keeps ones found before outside of them.
+     * A face found before that touches a region is searched again: the region grows to cover it with
+     * MOTION_PAD around, so a face that moved only partly into the motion is not lost.
+     * @param Frame
+     * @param Regions that moved
+     * @param Faces and eyes of the previous frame, replaced by ones of this frame
+     * @return Part of the frame searched, 0..1.
+     */
+    double findMoving(const Mat& frame, const vector<Rect>& regions, Detection& detection) {
+        mMoving.faces.clear();
+        mMoving.eyes.clear();
+        mRegions.assign(regions.begin(), regions.end());
+        Rect whole(0, 0, frame.cols, frame.rows);
+
+        // A grown region may touch more faces, so it grows until every face is either inside or outside.
+        for (bool grown = true; grown; ) {
+            grown = false;
+            for (size_t i = 0; i < detection.faces.size(); ++i) {
+                const Rect& face = detection.faces[i];
+                Rect padded = Rect(face.x - MOTION_PAD, face.y - MOTION_PAD, face.width + 2 * MOTION_PAD,
+                    face.height + 2 * MOTION_PAD) & whole;
+                for (size_t j = 0; j < mRegions.size(); ++j) {
+                    if ((face & mRegions[j]).area() > 0 && (padded & mRegions[j]) != padded) {
+                        mRegions[j] |= padded;
+                        grown = true;
+                    }
+                }
+            }
+            Motion::merge(mRegions);
+        }
+
+        for (size_t i = 0; i < detection.faces.size(); ++i) {
+            const Rect& face = detection.faces[i];
+            bool moved = false;
+            for (size_t j = 0; j < mRegions.size() && !moved; ++j) {
+                moved = (face & mRegions[j]).area() > 0;
+            }
+            if (moved) {
+                continue;
+            }
+            mMoving.faces.push_back(face);
+            for (size_t j = 0; j < detection.eyes.size(); ++j) {
+                const Rect& eye = detection.eyes[j];
+                if (face.contains(Point(eye.x + eye.width / 2, eye.y + eye.height / 2))) {
+                    mMoving.eyes.push_back(eye);
+                }
+            }
+        }
+
+        double area = 0;
+        for (size_t i = 0; i < mRegions.size(); ++i) {
+            area += mRegions[i].area();
+            mDetector.find(frame(mRegions[i]), mFound);
+            for (size_t j = 0; j < mFound.faces.size(); ++j) {
+                mMoving.faces.push_back(mFound.faces[j] + mRegions[i].tl());
+            }
+            for (size_t j = 0; j < mFound.eyes.size(); ++j) {
+                mMoving.eyes.push_back(mFound.eyes[j] + mRegions[i].tl());
+            }
+        }
+        detection.faces.swap(mMoving.faces);
+        detection.eyes.swap(mMoving.eyes);
+
+        return area / whole.area();
+    }
+
+    Detector& mDetector;
+    Tracker mTracker;
+    Motion mMotion;
+    bool mGated;
+
+    /**
+     * Results of findMoving(), kept to reuse buffers.
+     */
+    Detection mMoving;
+    Detection mFound;
+
+    /**
+     * Regions searched by findMoving(), grown by faces they touch.
+     */
+    vector<Rect> mRegions;
+
+    /**
+     * Counters of the last run().
+     */
+    size_t mFrames;
+    size_t mKeyframes;
+
+    /**
+     * Frames without motion and the sum of keyframe parts searched.
+     */
+    size_t mStill;
+    double mScanned;
+    double mSeconds;
+
+    /**
+     * Milliseconds spent on every frame.
+     */
+    vector<double> mLatencies;
 };
 
+/**
+ * @return Number of cores for each of \a users, at least 1.
+ */
+unsigned coresPer(unsigned users) {
+    return max(1u, thread::hardware_concurrency() / max(1u, users));
+}
+
 void showHelp(const char *appName) {
-    cerr <<  "Usage: " << appName << " FILENAME-or-DIR [OUTPUT_FILENAME-or-DIR]\n";
+    cerr <<  "Usage: " << appName << " [OPTIONS] FILENAME-or-DIR [OUTPUT_FILENAME-or-DIR]\n" <<
+        "       " << appName << " [OPTIONS] --video SOURCE [OUTPUT_VIDEO]\n" <<
+        "Options:\n" <<
+        "  -j, --threads N  Process images by N threads, needs output. 1 by default.\n" <<
+        "  --eye-threads N  Look for eyes of different faces of an image by N threads. 1 by default.\n" <<
+        "  --min-face N     Skip faces smaller than N pixels and detect on images downscaled accordingly.\n" <<
+        "  --work-size N    Do not downscale images to a longer side smaller than N pixels.\n" <<
+        "  --refine         Detect faces found on downscaled images again on full resolution.\n" <<
+        "  --tiles SIZE[:MAX_FACE]\n" <<
+        "                   Split images bigger than SIZE pixels into tiles overlapping by MAX_FACE pixels.\n" <<
+        "                   SIZE is at least " << 2 * Detector::MIN_SIZE << ", MAX_FACE at most SIZE/2, SIZE/4 by default.\n" <<
+        "  --tile-threads N Detect tiles of an image by N threads.\n" <<
+        "                   Number of cores divided by the number of detecting threads by default.\n" <<
+        "  --eye-band F     Search eyes only in the upper F part of every face, for eyes at least 15% of the face wide\n" <<
+        "                   and never smaller than without the band.\n" <<
+        "  --deadline MS    Relax scale factor, minimum face size and eyes so detection of an image is predicted\n" <<
+        "                   to take less than MS milliseconds. Prints settings chosen per image to stderr. Not for video.\n" <<
+        "  --pipeline D:T:E Process images by a pipeline of D decoding, T detecting and E encoding threads, needs output.\n" <<
+        "  --queue-depth J:D:T\n" <<
+        "                   Capacity of pipeline queues in front of decoding, detection and encoding. 16 by default.\n" <<
+        "  --readahead N    Ask the kernel to read N files ahead of processing.\n" <<
+        "  --cache FILE     Keep results in FILE and skip images that did not change since the last run.\n" <<
+        "                   Results of other cascades or detection options are discarded.\n" <<
+        "  --face-cascade FILE\n" <<
+        "                   Face cascade, OpenCV XML or binary made by cascadec. haarcascade_frontalface_alt.xml by default.\n" <<
+        "  --eyes-cascade FILE\n" <<
+        "                   Eyes cascade. haarcascade_eye_tree_eyeglasses.xml by default.\n" <<
+        "  --backend opencv|native|compiled\n" <<
+        "                   Evaluate cascades by OpenCV, by the built-in evaluator or by code generated for bundled cascades.\n" <<
+        "                   Binary cascades need a built-in one, the native one is used for them by default.\n" <<
+        "  --format json|binary\n" <<
+        "                   Write a record with faces and eyes per image instead of annotated images.\n" <<
+        "  --records FILE   Where records go, stdout by default.\n" <<
+        "  --stats          Print processing counters to stderr.\n" <<
+        "                   Operator new calls are counted by builds with -DFD_COUNT_ALLOCATIONS only.\n" <<
+        "  --video SOURCE   Detect faces in a video file, URL or camera if SOURCE is a number.\n" <<
+        "                   The cascade runs on keyframes only, faces are tracked between them.\n" <<
+        "  --keyframes MIN:MAX\n" <<
+        "                   Frames between keyframes, adapted to motion and tracking confidence. 2:32 by default.\n" <<
+        "  --motion         Search keyframes only where the scene moved, for fixed cameras.\n";
+}
+
+/**
+ * Describes a cascade file by its path, size and modification time.
+ */
+void describeFile(ostream& out, const string& path) {
+    struct stat st;
+    if (stat(path.c_str(), &st) != 0) {
+        memset(&st, 0, sizeof(st));
+    }
+    out << path << '@' << st.st_size << ':' << st.st_mtim.tv_sec << '.' << st.st_mtim.tv_nsec << '\n';
 }
 
 int main(int argc, const char** argv) {
     string path;
     string output;
+    unsigned threads = 1;
+    unsigned eyeThreads = 1;
+    int minFace = 0;
+    int workSize = 0;
+    bool refine = false;
+    int tiling[2] = {0, 0};
+
+    // 0 until known how many detectors share the cores.
+    unsigned tileThreads = 0;
+    double deadline = 0;
+    double eyeBand = 1;
+    unsigned stages[3] = {0, 0, 0};
+    size_t depth[3] = {16, 16, 16};
+    bool stats = false;
+    size_t readahead = 0;
+    string cacheFile;
+    string faceCascade = "haarcascade_frontalface_alt.xml";
+    string eyesCascade = "haarcascade_eye_tree_eyeglasses.xml";
+    Backend backend = BACKEND_AUTO;
+    unique_ptr<RecordWriter> records;
+    RecordWriter::Format format = RecordWriter::JSON;
+    string recordsFile = "-";
+    string video;
+    int keyframes[2] = {2, 32};
+    bool motion = false;
 
-    if (argc > 1) {
-        path = argv[1];
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if ((arg == "-j" || arg == "--threads") && i + 1 < argc) {
+            threads = max(1, atoi(argv[++i]));
+        } else if (arg == "--eye-threads" && i + 1 < argc) {
+            eyeThreads = max(1, atoi(argv[++i]));
+        } else if (arg == "--min-face" && i + 1 < argc) {
+            minFace = max(0, atoi(argv[++i]));
+        } else if (arg == "--work-size" && i + 1 < argc) {
+            workSize = max(0, atoi(argv[++i]));
+        } else if (arg == "--refine") {
+            refine = true;
+        } else if (arg == "--tiles" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d", &tiling[0], &tiling[1]) < 1 || tiling[0] <= 0 || tiling[1] < 0) {
+                showHelp(argv[0]);
+                return 1;
+            }
+            // Tiles must overlap by a whole face and still advance.
+            if (tiling[0] < 2 * Detector::MIN_SIZE || tiling[1] > tiling[0] / 2) {
+                cerr << "--tiles needs SIZE of at least " << 2 * Detector::MIN_SIZE << " and MAX_FACE of at most SIZE/2" <<
+                    endl;
+                return 1;
+            }
+        } else if (arg == "--tile-threads" && i + 1 < argc) {
+            tileThreads = max(1, atoi(argv[++i]));
+        } else if (arg == "--eye-band" && i + 1 < argc) {
+            eyeBand = atof(argv[++i]);
+            if (eyeBand <= 0 || eyeBand > 1) {
+                showHelp(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--deadline" && i + 1 < argc) {
+            deadline = max(0., atof(argv[++i]));
+        } else if (arg == "--pipeline" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%u:%u:%u", &stages[0], &stages[1], &stages[2]) != 3 ||
+                !stages[0] || !stages[1] || !stages[2]) {
+                showHelp(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--queue-depth" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%zu:%zu:%zu", &depth[0], &depth[1], &depth[2]) != 3 ||
+                !depth[0] || !depth[1] || !depth[2]) {
+                showHelp(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--readahead" && i + 1 < argc) {
+            readahead = max(0, atoi(argv[++i]));
+        } else if (arg == "--cache" && i + 1 < argc) {
+            cacheFile = argv[++i];
+        } else if (arg == "--face-cascade" && i + 1 < argc) {
+            faceCascade = argv[++i];
+        } else if (arg == "--eyes-cascade" && i + 1 < argc) {
+            eyesCascade = argv[++i];
+        } else if (arg == "--backend" && i + 1 < argc) {
+            if (!parseBackend(argv[++i], backend)) {
+                showHelp(argv[0]);
+                return 1;
+            }
+        } else if (arg == "--format" && i + 1 < argc) {
+            string name = argv[++i];
+            if (name == "json") {
+                format = RecordWriter::JSON;
+            } else if (name == "binary") {
+                format = RecordWriter::BINARY;
+            } else {
+                showHelp(argv[0]);
+                return 1;
+            }
+            records.reset(new RecordWriter);
+        } else if (arg == "--records" && i + 1 < argc) {
+            recordsFile = argv[++i];
+        } else if (arg == "--stats") {
+            stats = true;
+        } else if (arg == "--video" && i + 1 < argc) {
+            video = argv[++i];
+        } else if (arg == "--motion") {
+            motion = true;
+        } else if (arg == "--keyframes" && i + 1 < argc) {
+            if (sscanf(argv[++i], "%d:%d", &keyframes[0], &keyframes[1]) != 2 ||
+                keyframes[0] < 1 || keyframes[1] < keyframes[0]) {
+                showHelp(argv[0]);
+                return 1;
+            }
+        } else {
+            args.push_back(arg);
+        }
+    }
+    if (!video.empty()) {
+        // The source is the input, the only argument is the output video.
+        args.insert(args.begin(), video);
+    }
+    if (args.size() > 0) {
+        path = args[0];
     }
-    if (argc > 2) {
-        output = argv[2];
+    if (args.size() > 1) {
+        output = args[1];
     }
 
-    if (path.empty()) {
+    // Records replace annotated images.
+    if (path.empty() || (records && !output.empty())) {
         showHelp(argv[0]);
         return 1;
     }
 
-    Detector* detector = createDetector("haarcascade_frontalface_alt.xml",
-        "haarcascade_eye_tree_eyeglasses.xml");
+    // Keyframes of a video are paced by --keyframes, settings chosen per frame would never be reported.
+    if (!video.empty() && deadline > 0) {
+        cerr << "--deadline is not supported with --video" << endl;
+        return 1;
+    }
+    if (records && !records->open(recordsFile, format)) {
+        cerr << "Could not write " << recordsFile << endl;
+        return 1;
+    }
+
+    if (!video.empty()) {
+        if (tileThreads == 0) {
+            tileThreads = coresPer(1);
+        }
+        unique_ptr<Detector> detector(createDetector(faceCascade.c_str(), eyesCascade.c_str(), backend, eyeThreads,
+            tiling[0] > 0 ? tileThreads : 1));
+        if (!detector) {
+            cout << "Could not load cascade files." << endl;
+            return 2;
+        }
+        detector->setDownscale(minFace, workSize, refine);
+        detector->setTiling(tiling[0], tiling[1]);
+        detector->setEyeBand(eyeBand);
+
+        VideoStream stream(*detector, keyframes[0], keyframes[1], motion);
+        if (!stream.run(video, output, records.get())) {
+            cerr << "Could not process video " << video << endl;
+            return 1;
+        }
+        stream.report(cerr);
+        if (records && !records->close()) {
+            cerr << "Could not write " << recordsFile << endl;
+            return 1;
+        }
+        return 0;
+    }
+
+    bool pipeline = stages[0] > 0;
+    if (pipeline) {
+        threads = stages[1];
+    }
+
+    // Without output every image is shown in a dialog, that can't be done from many threads.
+    if (output.empty() && !records) {
+        threads = 1;
+        pipeline = false;
+    }
+
+    // Every detector has its own tile pool, together they keep the cores busy without oversubscribing them.
+    if (tileThreads == 0) {
+        tileThreads = coresPer(threads);
+    }
+
+    chrono::steady_clock::time_point startup = chrono::steady_clock::now();
+    vector<Detector*> detectors;
+    for (unsigned i = 0; i < threads; ++i) {
+        Detector* detector = createDetector(faceCascade.c_str(), eyesCascade.c_str(), backend, eyeThreads,
+            tiling[0] > 0 ? tileThreads : 1);
+
+        if (detector == 0) {
+            cout << "Could not load cascade files." << endl;
+            for (size_t j = 0; j < detectors.size(); ++j) {
+                delete detectors[j];
+            }
+            return 2;
+        }
+        detector->setDownscale(minFace, workSize, refine);
+        detector->setTiling(tiling[0], tiling[1]);
+        detector->setDeadline(deadline);
+        detector->setEyeBand(eyeBand);
+        detectors.push_back(detector);
+    }
+    if (stats) {
+        cerr << "startup: " << detectors.size() << " detectors loaded in " <<
+            chrono::duration<double, milli>(chrono::steady_clock::now() - startup).count() << " ms" << endl;
+    }
+
+    unique_ptr<ResultCache> cache;
+    if (!cacheFile.empty()) {
+        // Everything that changes what is found, cached results of other settings are not reused.
+        ostringstream settings;
+        describeFile(settings, faceCascade);
+        describeFile(settings, eyesCascade);
+        settings << backend << ' ' << minFace << ' ' << workSize << ' ' << refine << ' ' << tiling[0] << ':' <<
+            tiling[1] << ' ' << deadline << ' ' << eyeBand;
+        cache.reset(new ResultCache(settings.str()));
+        if (!cache->load(cacheFile)) {
+            cerr << "Ignoring broken cache " << cacheFile << endl;
+            cache.reset(new ResultCache(settings.str()));
+        }
+    }
 
-    if (detector == 0) {
-        cout << "Could not load cascade files." << endl;
-        return 2;
+    Processor* processor;
+    if (pipeline) {
+        processor = new PipelineProcessor(stages[0], detectors, stages[2], depth, cache.get(), records.get());
+    } else if (threads > 1) {
+        processor = new PoolProcessor(detectors, threads * 4, cache.get(), records.get());
+    } else {
+        processor = new SerialProcessor(detectors[0], cache.get(), records.get());
     }
 
-    Reader reader(*detector, output);
+    Reader reader(*processor, output, readahead);
     if (!reader.read(path)) {
         cerr << "Could not find any faces in " << path << endl;
     }
+    if (stats) {
+        reader.report(cerr);
+        processor->report(cerr);
+    }
+    delete processor;
 
-    delete detector;
-    return 0;
-}
\ No newline at end of file
+    // Like for videos, unwritten records fail the run, the cache is still saved.
+    int result = 0;
+    if (records) {
+        if (!records->close()) {
+            cerr << "Could not write " << recordsFile << endl;
+            result = 1;
+        }
+        if (stats) {
+            records->report(cerr);
+        }
+    }
+
+    if (cache) {
+        if (stats) {
+            cache->report(cerr);
+        }
+        if (!cache->save(cacheFile)) {
+            cerr << "Could not write cache " << cacheFile << endl;
+        }
+    }
+    return result;
+}
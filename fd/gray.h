@@ -0,0 +1,173 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Grayscale conversion fused with histogram equalization.
+ */
+
+#ifndef SULPRE_FD_GRAY_H
+#define SULPRE_FD_GRAY_H
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <cstring>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+/**
+ * Luma of a BGR pixel: (B * 1868 + G * 9617 + R * 4899 + 8192) >> 14, fixed point coefficients of OpenCV for 8 bits.
+ */
+inline unsigned char luma(const unsigned char* bgr) {
+    return static_cast<unsigned char>((bgr[0] * 1868 + bgr[1] * 9617 + bgr[2] * 4899 + (1 << 13)) >> 14);
+}
+
+#ifdef __SSE2__
+
+/**
+ * Luma of 8 pixels, whose channels are zero extended to 16 bits, by the coefficients of luma().
+ */
+inline __m128i luma8(__m128i b, __m128i g, __m128i r) {
+    const __m128i bg = _mm_setr_epi16(1868, 9617, 1868, 9617, 1868, 9617, 1868, 9617);
+    const __m128i r1 = _mm_setr_epi16(4899, 1 << 13, 4899, 1 << 13, 4899, 1 << 13, 4899, 1 << 13);
+    const __m128i one = _mm_set1_epi16(1);
+    __m128i lo = _mm_add_epi32(_mm_madd_epi16(_mm_unpacklo_epi16(b, g), bg),
+        _mm_madd_epi16(_mm_unpacklo_epi16(r, one), r1));
+    __m128i hi = _mm_add_epi32(_mm_madd_epi16(_mm_unpackhi_epi16(b, g), bg),
+        _mm_madd_epi16(_mm_unpackhi_epi16(r, one), r1));
+
+    return _mm_packs_epi32(_mm_srai_epi32(lo, 14), _mm_srai_epi32(hi, 14));
+}
+
+/**
+ * Luma of 16 pixels given by their channels.
+ */
+inline void luma16(__m128i b, __m128i g, __m128i r, unsigned char* dst) {
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo = luma8(_mm_unpacklo_epi8(b, zero), _mm_unpacklo_epi8(g, zero), _mm_unpacklo_epi8(r, zero));
+    __m128i hi = luma8(_mm_unpackhi_epi8(b, zero), _mm_unpackhi_epi8(g, zero), _mm_unpackhi_epi8(r, zero));
+    _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), _mm_packus_epi16(lo, hi));
+}
+
+/**
+ * Luma of 32 BGR pixels.
+ * Five rounds of interleaving chunk k with chunk k + 3 turn 96 bytes of BGR into B, G and R of 16 pixels each.
+ */
+inline void luma32(const unsigned char* bgr, unsigned char* dst) {
+    const __m128i* p = reinterpret_cast<const __m128i*>(bgr);
+    __m128i v0 = _mm_loadu_si128(p);
+    __m128i v1 = _mm_loadu_si128(p + 1);
+    __m128i v2 = _mm_loadu_si128(p + 2);
+    __m128i v3 = _mm_loadu_si128(p + 3);
+    __m128i v4 = _mm_loadu_si128(p + 4);
+    __m128i v5 = _mm_loadu_si128(p + 5);
+    for (int round = 0; round < 5; ++round) {
+        __m128i t0 = _mm_unpacklo_epi8(v0, v3);
+        __m128i t1 = _mm_unpackhi_epi8(v0, v3);
+        __m128i t2 = _mm_unpacklo_epi8(v1, v4);
+        __m128i t3 = _mm_unpackhi_epi8(v1, v4);
+        __m128i t4 = _mm_unpacklo_epi8(v2, v5);
+        __m128i t5 = _mm_unpackhi_epi8(v2, v5);
+        v0 = t0;
+        v1 = t1;
+        v2 = t2;
+        v3 = t3;
+        v4 = t4;
+        v5 = t5;
+    }
+
+    // B of pixels 0-15, B of 16-31, G of 0-15, G of 16-31, R of 0-15 and R of 16-31.
+    luma16(v0, v2, v4, dst);
+    luma16(v1, v3, v5, dst + 16);
+}
+
+#endif
+
+/**
+ * Same as cvtColor(CV_BGR2GRAY) followed by equalizeHist(), but reads the color image once:
+ * the first pass computes luma of each row and counts its histogram while the row is in cache,
+ * the second one applies the lookup table in place. With SSE2 luma is computed for 32 pixels at once.
+ * @param 8 bit BGR image, other types are converted by OpenCV
+ * @param Equalized grayscale image, its buffer is reused if the size does not change
+ */
+inline void equalizedGray(const cv::Mat& bgr, cv::Mat& gray) {
+    if (bgr.type() != CV_8UC3) {
+        if (bgr.channels() == 1) {
+            bgr.copyTo(gray);
+        } else {
+            cv::cvtColor(bgr, gray, bgr.channels() == 4 ? CV_BGRA2GRAY : CV_BGR2GRAY);
+        }
+        cv::equalizeHist(gray, gray);
+        return;
+    }
+
+    gray.create(bgr.rows, bgr.cols, CV_8UC1);
+
+    // Few histograms so successive equal pixels do not wait for each other's increments.
+    uint32_t hist[4][256] = {{0}};
+    for (int y = 0; y < bgr.rows; ++y) {
+        const unsigned char* src = bgr.ptr<unsigned char>(y);
+        unsigned char* dst = gray.ptr<unsigned char>(y);
+        int x = 0;
+#ifdef __SSE2__
+        for (; x + 32 <= bgr.cols; x += 32, src += 96) {
+            luma32(src, dst + x);
+        }
+#endif
+        for (; x < bgr.cols; ++x, src += 3) {
+            dst[x] = luma(src);
+        }
+
+        // Counted from the row just written, which is still in cache.
+        for (x = 0; x + 4 <= bgr.cols; x += 4) {
+            ++hist[0][dst[x]];
+            ++hist[1][dst[x + 1]];
+            ++hist[2][dst[x + 2]];
+            ++hist[3][dst[x + 3]];
+        }
+        for (; x < bgr.cols; ++x) {
+            ++hist[0][dst[x]];
+        }
+    }
+
+    // Lookup table like equalizeHist() builds it.
+    uint32_t total = uint32_t(bgr.rows) * bgr.cols;
+    uint32_t h[256];
+    for (int i = 0; i < 256; ++i) {
+        h[i] = hist[0][i] + hist[1][i] + hist[2][i] + hist[3][i];
+    }
+    int i = 0;
+    while (i < 256 && h[i] == 0) {
+        ++i;
+    }
+    if (i == 256) {
+        return;
+    }
+
+    unsigned char lut[256];
+    if (h[i] == total) {
+        memset(lut, i, sizeof(lut));
+    } else {
+        memset(lut, 0, sizeof(lut));
+        float scale = 255.f / (total - h[i]);
+        uint32_t sum = 0;
+        for (++i; i < 256; ++i) {
+            sum += h[i];
+            lut[i] = cv::saturate_cast<unsigned char>(sum * scale);
+        }
+    }
+
+    for (int y = 0; y < gray.rows; ++y) {
+        unsigned char* p = gray.ptr<unsigned char>(y);
+        for (int x = 0; x < gray.cols; ++x) {
+            p[x] = lut[p[x]];
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,1125 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Built-in Haar cascade: flat model of stages, trees and features,
+ * loadable from OpenCV XML or from a compact binary that is used right from the mapping,
+ * and its scalar, SSE2 and generated evaluators.
+ */
+
+#ifndef SULPRE_FD_HAAR_H
+#define SULPRE_FD_HAAR_H
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+#include "opencv2/objdetect/objdetect.hpp"
+
+#include "../common/imgio.h"
+
+#include <cmath>
+#include <cstring>
+#include <deque>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <vector>
+#include <stdint.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+namespace haar {
+
+/**
+ * Layout of the binary cascade. All fields are 4 bytes wide, so arrays follow each other without padding:
+ * FileHeader, Stage[stages], Tree[trees], Node[nodes], float leaves[leaves], Feature[features].
+ */
+struct FileHeader {
+    char magic[4];
+    uint32_t version;
+
+    /**
+     * Size of the detection window.
+     */
+    int32_t width;
+    int32_t height;
+
+    uint32_t stages;
+    uint32_t trees;
+    uint32_t nodes;
+    uint32_t leaves;
+    uint32_t features;
+};
+
+const char MAGIC[4] = {'S', 'P', 'H', 'C'};
+const uint32_t VERSION = 1;
+
+/**
+ * Consecutive trees whose sum is compared with the threshold.
+ */
+struct Stage {
+    float threshold;
+    int32_t firstTree;
+    int32_t treeCount;
+};
+
+/**
+ * Trees follow each other in the arrays, nodes and leaves of a tree end where the next tree starts.
+ */
+struct Tree {
+    int32_t firstNode;
+    int32_t firstLeaf;
+};
+
+/**
+ * Node of a tree. A child > 0 is an index of a node in the same tree,
+ * otherwise minus index of a leaf of the tree, like in OpenCV.
+ */
+struct Node {
+    int32_t feature;
+    float threshold;
+    int32_t left;
+    int32_t right;
+};
+
+struct FeatureRect {
+    int32_t x;
+    int32_t y;
+    int32_t width;
+    int32_t height;
+    float weight;
+};
+
+/**
+ * Up to three weighted rectangles, upright or rotated by 45 degrees.
+ */
+struct Feature {
+    FeatureRect rect[3];
+    int32_t count;
+    int32_t tilted;
+};
+
+/**
+ * Stage thresholds are lowered by this bias when evaluating, as OpenCV does.
+ */
+const double STAGE_THRESHOLD_BIAS = 0.0001;
+
+/**
+ * Scale of weights of tilted features. OpenCV up to 3.x runs cascades of the old XML format by its C code,
+ * which halves them; OpenCV 4 converts such cascades on load and uses the weights as they are.
+ * The built-in evaluators follow the OpenCV they are built with, so both backends find the same objects.
+ */
+#if CV_MAJOR_VERSION >= 4
+const double TILTED_WEIGHT_SCALE = 1;
+#else
+const double TILTED_WEIGHT_SCALE = 0.5;
+#endif
+
+/**
+ * Cascade model. Arrays point either into own storage or into the mapped binary file.
+ */
+class Cascade {
+public:
+
+    Cascade() : mHeader(0), mStages(0), mTrees(0), mNodes(0), mLeaves(0), mFeatures(0) {}
+
+    /**
+     * Loads a binary cascade or an OpenCV XML cascade of the old Haar format.
+     * @return false If could not load.
+     */
+    bool load(const std::string& filename) {
+        if (!mFile.open(filename)) {
+            return false;
+        }
+        if (mFile.size() >= sizeof(FileHeader) && memcmp(mFile.data(), MAGIC, sizeof(MAGIC)) == 0) {
+            return attach(mFile.data(), mFile.size());
+        }
+        mFile.close();
+
+        return loadXml(filename);
+    }
+
+    /**
+     * Writes the cascade in the binary format.
+     * @return false If could not write.
+     */
+    bool save(const std::string& filename) const {
+        if (!mHeader) {
+            return false;
+        }
+
+        std::ofstream out(filename.c_str(), std::ios::binary);
+        out.write(reinterpret_cast<const char*>(mHeader), sizeof(FileHeader));
+        out.write(reinterpret_cast<const char*>(mStages), sizeof(Stage) * mHeader->stages);
+        out.write(reinterpret_cast<const char*>(mTrees), sizeof(Tree) * mHeader->trees);
+        out.write(reinterpret_cast<const char*>(mNodes), sizeof(Node) * mHeader->nodes);
+        out.write(reinterpret_cast<const char*>(mLeaves), sizeof(float) * mHeader->leaves);
+        out.write(reinterpret_cast<const char*>(mFeatures), sizeof(Feature) * mHeader->features);
+
+        return bool(out);
+    }
+
+    bool empty() const {
+        return mHeader == 0;
+    }
+
+    cv::Size window() const {
+        return cv::Size(mHeader->width, mHeader->height);
+    }
+
+    size_t stageCount() const { return mHeader->stages; }
+    size_t treeCount() const { return mHeader->trees; }
+    size_t nodeCount() const { return mHeader->nodes; }
+    size_t leafCount() const { return mHeader->leaves; }
+    size_t featureCount() const { return mHeader->features; }
+
+    const Stage* stages() const { return mStages; }
+    const Tree* trees() const { return mTrees; }
+    const Node* nodes() const { return mNodes; }
+    const float* leaves() const { return mLeaves; }
+    const Feature* features() const { return mFeatures; }
+
+    /**
+     * FNV-1a hash of the window size and all arrays, identifies the cascade whatever file it was loaded from.
+     */
+    uint64_t hash() const {
+        uint64_t h = 14695981039346656037ULL;
+        const void* parts[6] = {&mHeader->width, mStages, mTrees, mNodes, mLeaves, mFeatures};
+        size_t sizes[6] = {
+            sizeof(uint32_t) * 2, sizeof(Stage) * stageCount(), sizeof(Tree) * treeCount(),
+            sizeof(Node) * nodeCount(), sizeof(float) * leafCount(), sizeof(Feature) * featureCount()
+        };
+        for (int i = 0; i < 6; ++i) {
+            const unsigned char* p = static_cast<const unsigned char*>(parts[i]);
+            for (size_t j = 0; j < sizes[i]; ++j) {
+                h = (h ^ p[j]) * 1099511628211ULL;
+            }
+        }
+
+        return h;
+    }
+
+    /**
+     * Checks if any feature is rotated, then the tilted integral is needed.
+     */
+    bool hasTilted() const {
+        for (size_t i = 0; i < featureCount(); ++i) {
+            if (mFeatures[i].tilted) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+
+    Cascade(const Cascade&);
+    Cascade& operator=(const Cascade&);
+
+    /**
+     * Points arrays into a binary image of the cascade and validates it.
+     */
+    bool attach(const unsigned char* data, size_t size) {
+        const FileHeader* h = reinterpret_cast<const FileHeader*>(data);
+        size_t expected = sizeof(FileHeader) + sizeof(Stage) * size_t(h->stages) + sizeof(Tree) * size_t(h->trees) +
+            sizeof(Node) * size_t(h->nodes) + sizeof(float) * size_t(h->leaves) + sizeof(Feature) * size_t(h->features);
+        if (h->version != VERSION || size < expected || h->width <= 2 || h->height <= 2) {
+            return false;
+        }
+
+        const unsigned char* p = data + sizeof(FileHeader);
+        mStages = reinterpret_cast<const Stage*>(p);
+        p += sizeof(Stage) * h->stages;
+        mTrees = reinterpret_cast<const Tree*>(p);
+        p += sizeof(Tree) * h->trees;
+        mNodes = reinterpret_cast<const Node*>(p);
+        p += sizeof(Node) * h->nodes;
+        mLeaves = reinterpret_cast<const float*>(p);
+        p += sizeof(float) * h->leaves;
+        mFeatures = reinterpret_cast<const Feature*>(p);
+
+        // Indices must stay inside arrays and walks through trees must end whatever the file contains.
+        for (uint32_t s = 0; s < h->stages; ++s) {
+            if (mStages[s].firstTree < 0 || mStages[s].treeCount < 0 ||
+                int64_t(mStages[s].firstTree) + mStages[s].treeCount > int64_t(h->trees)) {
+                return false;
+            }
+        }
+        for (uint32_t t = 0; t < h->trees; ++t) {
+            int64_t firstNode = mTrees[t].firstNode;
+            int64_t firstLeaf = mTrees[t].firstLeaf;
+            int64_t endNode = t + 1 < h->trees ? mTrees[t + 1].firstNode : int64_t(h->nodes);
+            int64_t endLeaf = t + 1 < h->trees ? mTrees[t + 1].firstLeaf : int64_t(h->leaves);
+            if (firstNode < 0 || firstLeaf < 0 || endNode <= firstNode || endLeaf <= firstLeaf ||
+                endNode > int64_t(h->nodes) || endLeaf > int64_t(h->leaves)) {
+                return false;
+            }
+            for (int64_t n = 0; n < endNode - firstNode; ++n) {
+                const Node& node = mNodes[firstNode + n];
+                if (!validChild(node.left, n, endNode - firstNode, endLeaf - firstLeaf) ||
+                    !validChild(node.right, n, endNode - firstNode, endLeaf - firstLeaf)) {
+                    return false;
+                }
+            }
+        }
+        for (uint32_t n = 0; n < h->nodes; ++n) {
+            if (mNodes[n].feature < 0 || uint32_t(mNodes[n].feature) >= h->features) {
+                return false;
+            }
+        }
+        for (uint32_t f = 0; f < h->features; ++f) {
+            if (mFeatures[f].count < 1 || mFeatures[f].count > 3) {
+                return false;
+            }
+            for (int32_t r = 0; r < mFeatures[f].count; ++r) {
+                if (!validRect(mFeatures[f].rect[r], mFeatures[f].tilted != 0, h->width, h->height)) {
+                    return false;
+                }
+            }
+        }
+
+        mHeader = h;
+        return true;
+    }
+
+    /**
+     * @param Child of a node
+     * @param Index of the node in its tree
+     * @param Number of nodes of the tree
+     * @param Number of leaves of the tree
+     * @return true If the child is a later node of the tree, so walks always end, or a leaf of the tree.
+     */
+    static bool validChild(int32_t child, int64_t node, int64_t nodes, int64_t leaves) {
+        return child > 0 ? child > node && child < nodes : -int64_t(child) < leaves;
+    }
+
+    /**
+     * @return true If the rectangle is inside the detection window, so integrals are never read outside
+     * of the scanned image. A tilted rectangle spans height to the left of x and width + height below y.
+     */
+    static bool validRect(const FeatureRect& r, bool tilted, int32_t width, int32_t height) {
+        int64_t x = r.x;
+        int64_t y = r.y;
+        if (r.x < 0 || r.y < 0 || r.width < 0 || r.height < 0) {
+            return false;
+        }
+        if (!tilted) {
+            return x + r.width <= width && y + r.height <= height;
+        }
+
+        return x - r.height >= 0 && x + r.width <= width && y + int64_t(r.width) + r.height <= height;
+    }
+
+    /**
+     * Reads the old Haar format as written by opencv_haartraining.
+     */
+    bool loadXml(const std::string& filename) {
+        cv::FileStorage fs(filename, cv::FileStorage::READ);
+        if (!fs.isOpened()) {
+            return false;
+        }
+
+        cv::FileNode root = fs.getFirstTopLevelNode();
+        cv::FileNode size = root["size"];
+        cv::FileNode stagesNode = root["stages"];
+        if (!size.isSeq() || size.size() != 2 || !stagesNode.isSeq()) {
+            return false;
+        }
+
+        FileHeader h;
+        memcpy(h.magic, MAGIC, sizeof(MAGIC));
+        h.version = VERSION;
+        h.width = int(size[0]);
+        h.height = int(size[1]);
+
+        std::vector<Stage> stages;
+        std::vector<Tree> trees;
+        std::vector<Node> nodes;
+        std::vector<float> leaves;
+        std::vector<Feature> features;
+
+        for (cv::FileNodeIterator s = stagesNode.begin(); s != stagesNode.end(); ++s) {
+            cv::FileNode treesNode = (*s)["trees"];
+            Stage stage = {float((*s)["stage_threshold"]), int32_t(trees.size()), 0};
+            for (cv::FileNodeIterator t = treesNode.begin(); t != treesNode.end(); ++t) {
+                Tree tree = {int32_t(nodes.size()), int32_t(leaves.size())};
+                int32_t leaf = 0;
+                for (cv::FileNodeIterator n = (*t).begin(); n != (*t).end(); ++n) {
+                    Feature feature;
+                    memset(&feature, 0, sizeof(feature));
+                    cv::FileNode rects = (*n)["feature"]["rects"];
+                    for (cv::FileNodeIterator r = rects.begin(); r != rects.end() && feature.count < 3; ++r) {
+                        FeatureRect& fr = feature.rect[feature.count++];
+                        fr.x = int((*r)[0]);
+                        fr.y = int((*r)[1]);
+                        fr.width = int((*r)[2]);
+                        fr.height = int((*r)[3]);
+                        fr.weight = float((*r)[4]);
+                    }
+                    feature.tilted = int((*n)["feature"]["tilted"]);
+                    if (feature.count == 0) {
+                        return false;
+                    }
+
+                    Node node;
+                    node.feature = int32_t(features.size());
+                    node.threshold = float((*n)["threshold"]);
+                    node.left = child(*n, "left_node", "left_val", leaves, leaf);
+                    node.right = child(*n, "right_node", "right_val", leaves, leaf);
+                    features.push_back(feature);
+                    nodes.push_back(node);
+                }
+                trees.push_back(tree);
+                ++stage.treeCount;
+            }
+            stages.push_back(stage);
+        }
+
+        h.stages = stages.size();
+        h.trees = trees.size();
+        h.nodes = nodes.size();
+        h.leaves = leaves.size();
+        h.features = features.size();
+
+        mStorage.clear();
+        append(&h, sizeof(h));
+        append(stages.empty() ? 0 : &stages[0], sizeof(Stage) * stages.size());
+        append(trees.empty() ? 0 : &trees[0], sizeof(Tree) * trees.size());
+        append(nodes.empty() ? 0 : &nodes[0], sizeof(Node) * nodes.size());
+        append(leaves.empty() ? 0 : &leaves[0], sizeof(float) * leaves.size());
+        append(features.empty() ? 0 : &features[0], sizeof(Feature) * features.size());
+
+        return attach(reinterpret_cast<const unsigned char*>(&mStorage[0]), mStorage.size() * sizeof(uint32_t));
+    }
+
+    /**
+     * Reads a child of a node: either an index of a node or a leaf value.
+     */
+    static int32_t child(const cv::FileNode& node, const char* nodeName, const char* valName,
+        std::vector<float>& leaves, int32_t& leaf) {
+        cv::FileNode val = node[valName];
+        if (val.empty()) {
+            return int(node[nodeName]);
+        }
+        leaves.push_back(float(val));
+
+        return -(leaf++);
+    }
+
+    void append(const void* data, size_t size) {
+        size_t offset = mStorage.size();
+        mStorage.resize(offset + size / sizeof(uint32_t));
+        if (size) {
+            memcpy(&mStorage[offset], data, size);
+        }
+    }
+
+    /**
+     * Storage of a cascade loaded from XML, 4 byte aligned.
+     */
+    std::vector<uint32_t> mStorage;
+
+    /**
+     * Mapping of a binary cascade.
+     */
+    imgio::MappedFile mFile;
+
+    const FileHeader* mHeader;
+    const Stage* mStages;
+    const Tree* mTrees;
+    const Node* mNodes;
+    const float* mLeaves;
+    const Feature* mFeatures;
+};
+
+/**
+ * Image scaled for one detection pass with its integrals.
+ */
+struct Level {
+    /**
+     * Image was scaled down by this factor.
+     */
+    double factor;
+
+    cv::Mat image;
+
+    /**
+     * Integral, squared integral and integral of 45 degrees rotated rectangles.
+     */
+    cv::Mat sum;
+    cv::Mat sqsum;
+    cv::Mat tilted;
+};
+
+/**
+ * Levels of one image scaled down by powers of the same factor, built on demand and kept
+ * until the next image, so several cascades and regions of the image share resizing and integrals.
+ * Buffers of levels are reused between images.
+ * Levels may be requested from many threads, reset() may not.
+ */
+class Pyramid {
+public:
+
+    Pyramid() : mScaleFactor(0) {}
+
+    /**
+     * Starts a new image, forgets built levels.
+     */
+    void reset(const cv::Mat& gray, double scaleFactor) {
+        mGray = gray;
+        if (scaleFactor != mScaleFactor) {
+            mScaleFactor = scaleFactor;
+            mFactors.clear();
+        }
+        mBuilt.assign(mLevels.size(), NONE);
+    }
+
+    const cv::Mat& image() const {
+        return mGray;
+    }
+
+    /**
+     * Factor of level \a k, computed the same way detectMultiScale() steps through scales.
+     */
+    double factor(size_t k) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        return factorLocked(k);
+    }
+
+    /**
+     * @param Level index
+     * @param If the integral of rotated rectangles is needed
+     */
+    const Level& level(size_t k, bool tilted) {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mLevels.size() <= k) {
+            mLevels.resize(k + 1);
+            mBuilt.resize(k + 1, NONE);
+        }
+
+        Level& level = mLevels[k];
+        int need = tilted ? TILTED : UPRIGHT;
+        if (mBuilt[k] >= need) {
+            return level;
+        }
+        if (mBuilt[k] == NONE) {
+            level.factor = factorLocked(k);
+            cv::Size sz(cvRound(mGray.cols / level.factor), cvRound(mGray.rows / level.factor));
+            cv::resize(mGray, level.image, sz, 0, 0, cv::INTER_LINEAR);
+        }
+        if (!tilted) {
+            cv::integral(level.image, level.sum, level.sqsum);
+        } else if (mBuilt[k] == NONE) {
+            cv::integral(level.image, level.sum, level.sqsum, level.tilted);
+        } else {
+            // Other threads may read integrals of the level, only the tilted one is written.
+            cv::integral(level.image, mSum, mSqsum, level.tilted);
+        }
+        mBuilt[k] = need;
+
+        return level;
+    }
+
+private:
+
+    enum {
+        NONE,
+        UPRIGHT,
+        TILTED
+    };
+
+    double factorLocked(size_t k) {
+        while (mFactors.size() <= k) {
+            mFactors.push_back(mFactors.empty() ? 1 : mFactors.back() * mScaleFactor);
+        }
+
+        return mFactors[k];
+    }
+
+    cv::Mat mGray;
+    double mScaleFactor;
+    std::vector<double> mFactors;
+
+    /**
+     * Deque keeps levels in place when more are added while others are used.
+     */
+    std::deque<Level> mLevels;
+
+    /**
+     * What is built for every level.
+     */
+    std::vector<int> mBuilt;
+    std::mutex mMutex;
+
+    /**
+     * Throwaway integrals when only the tilted one is added to a level.
+     */
+    cv::Mat mSum;
+    cv::Mat mSqsum;
+};
+
+/**
+ * Evaluates a cascade like CascadeClassifier::detectMultiScale() with CV_HAAR_SCALE_IMAGE does:
+ * the image is scaled down step by step and the window of the cascade is moved over every level.
+ * Not thread safe, but many classifiers may share one cascade.
+ */
+class Classifier {
+public:
+
+    Classifier(const Cascade& cascade) : mCascade(cascade), mStep(0) {
+        mTilted = cascade.hasTilted();
+        cv::Size w = cascade.window();
+        mInvArea = 1. / ((w.width - 2) * (w.height - 2));
+        weights(cascade, mWeights);
+    }
+
+    virtual ~Classifier() {}
+
+    /**
+     * Computes weights of rectangles, 3 per feature, unused ones are zero.
+     * Weights are normalized by the area of the window without its border,
+     * and the first rectangle compensates the others so a flat area gives zero.
+     */
+    static void weights(const Cascade& cascade, std::vector<float>& result) {
+        cv::Size w = cascade.window();
+        double invArea = 1. / ((w.width - 2) * (w.height - 2));
+        result.assign(cascade.featureCount() * 3, 0.f);
+        for (size_t i = 0; i < cascade.featureCount(); ++i) {
+            const Feature& f = cascade.features()[i];
+            double sum0 = 0;
+            for (int k = f.count - 1; k >= 0; --k) {
+                double weight = f.rect[k].weight * invArea * (f.tilted ? TILTED_WEIGHT_SCALE : 1);
+                if (k > 0) {
+                    sum0 += float(weight) * f.rect[k].width * f.rect[k].height;
+                    result[i * 3 + k] = float(weight);
+                } else {
+                    result[i * 3] = float(-sum0 / (f.rect[0].width * f.rect[0].height));
+                }
+            }
+        }
+    }
+
+    /**
+     * Detects objects of different sizes.
+     * @param Grayscale image
+     * @param Found objects
+     * @param How much the image is scaled down at each step
+     * @param Minimum number of neighbors each candidate should have to be kept
+     * @param Minimum object size
+     * @param Maximum object size, the image size if empty
+     */
+    void detectMultiScale(const cv::Mat& gray, std::vector<cv::Rect>& objects, double scaleFactor,
+        int minNeighbors, cv::Size minSize, cv::Size maxSize = cv::Size()) {
+        objects.clear();
+        if (maxSize.width == 0 || maxSize.height == 0) {
+            maxSize = gray.size();
+        }
+
+        cv::Size win0 = mCascade.window();
+        for (double factor = 1; ; factor *= scaleFactor) {
+            cv::Size win(cvRound(win0.width * factor), cvRound(win0.height * factor));
+            cv::Size sz(cvRound(gray.cols / factor), cvRound(gray.rows / factor));
+            if (sz.width - win0.width + 1 <= 0 || sz.height - win0.height + 1 <= 0) {
+                break;
+            }
+            if (win.width > maxSize.width || win.height > maxSize.height) {
+                break;
+            }
+            if (win.width < minSize.width || win.height < minSize.height) {
+                continue;
+            }
+
+            mLevel.factor = factor;
+            cv::resize(gray, mLevel.image, sz, 0, 0, cv::INTER_LINEAR);
+            integrate(mLevel);
+            scan(mLevel, cv::Rect(0, 0, sz.width, sz.height), objects);
+        }
+
+        if (minNeighbors != 0) {
+            cv::groupRectangles(objects, std::max(minNeighbors, 1), 0.2);
+        }
+    }
+
+    /**
+     * Detects objects inside a region of the image of the pyramid using its levels.
+     * Levels are scaled from the whole image, so results may slightly differ from
+     * detecting in the region cut out of the image.
+     * @param Pyramid of the image
+     * @param Region of the image
+     * @param Found objects in coordinates of the image
+     * @param Minimum number of neighbors each candidate should have to be kept
+     * @param Minimum object size
+     * @param Maximum object size, the region size if empty
+     */
+    void detectMultiScale(Pyramid& pyramid, const cv::Rect& roi, std::vector<cv::Rect>& objects,
+        int minNeighbors, cv::Size minSize, cv::Size maxSize = cv::Size()) {
+        objects.clear();
+        if (maxSize.width == 0 || maxSize.height == 0) {
+            maxSize = roi.size();
+        }
+
+        cv::Size win0 = mCascade.window();
+        for (size_t k = 0; ; ++k) {
+            double factor = pyramid.factor(k);
+            cv::Size win(cvRound(win0.width * factor), cvRound(win0.height * factor));
+            cv::Size sz(cvRound(roi.width / factor), cvRound(roi.height / factor));
+            if (sz.width - win0.width + 1 <= 0 || sz.height - win0.height + 1 <= 0) {
+                break;
+            }
+            if (win.width > maxSize.width || win.height > maxSize.height) {
+                break;
+            }
+            if (win.width < minSize.width || win.height < minSize.height) {
+                continue;
+            }
+
+            const Level& level = pyramid.level(k, mTilted);
+            cv::Rect area(cvRound(roi.x / factor), cvRound(roi.y / factor), sz.width, sz.height);
+            scan(level, area & cv::Rect(0, 0, level.image.cols, level.image.rows), objects);
+        }
+
+        if (minNeighbors != 0) {
+            cv::groupRectangles(objects, std::max(minNeighbors, 1), 0.2);
+        }
+    }
+
+protected:
+
+    /**
+     * Builds integrals of the level image.
+     */
+    void integrate(Level& level) const {
+        if (mTilted) {
+            cv::integral(level.image, level.sum, level.sqsum, level.tilted);
+        } else {
+            cv::integral(level.image, level.sum, level.sqsum);
+        }
+    }
+
+    /**
+     * Moves the window over the area of the level and collects candidates in coordinates of the original image.
+     */
+    virtual void scan(const Level& level, const cv::Rect& area, std::vector<cv::Rect>& candidates) {
+        cv::Size win0 = mCascade.window();
+        cv::Size win(cvRound(win0.width * level.factor), cvRound(win0.height * level.factor));
+        prepare(level);
+
+        int ystep = level.factor > 2 ? 1 : 2;
+        int yend = std::min(area.y + area.height, level.sum.rows - 1) - win0.height;
+        int xend = std::min(area.x + area.width, level.sum.cols - 1) - win0.width;
+        for (int y = area.y; y < yend; y += ystep) {
+            for (int x = area.x; x < xend; x += ystep) {
+                if (evaluate(level, x, y)) {
+                    candidates.push_back(cv::Rect(cvRound(x * level.factor), cvRound(y * level.factor),
+                        win.width, win.height));
+                }
+            }
+        }
+    }
+
+    /**
+     * Computes offsets of feature rectangles inside integrals for the row step of the level.
+     */
+    void prepare(const Level& level) {
+        int step = int(level.sum.step / sizeof(int));
+        if (step == mStep) {
+            return;
+        }
+        mStep = step;
+
+        cv::Size w = mCascade.window();
+        mWindowOffsets[0] = step + 1;
+        mWindowOffsets[1] = step + w.width - 1;
+        mWindowOffsets[2] = (w.height - 1) * step + 1;
+        mWindowOffsets[3] = (w.height - 1) * step + w.width - 1;
+
+        mOffsets.resize(mCascade.featureCount() * 3 * 4);
+        for (size_t i = 0; i < mCascade.featureCount(); ++i) {
+            const Feature& f = mCascade.features()[i];
+            for (int k = 0; k < 3; ++k) {
+                int* o = &mOffsets[(i * 3 + k) * 4];
+                if (k >= f.count) {
+                    o[0] = o[1] = o[2] = o[3] = 0;
+                    continue;
+                }
+                const FeatureRect& r = f.rect[k];
+                if (!f.tilted) {
+                    o[0] = r.y * step + r.x;
+                    o[1] = r.y * step + r.x + r.width;
+                    o[2] = (r.y + r.height) * step + r.x;
+                    o[3] = (r.y + r.height) * step + r.x + r.width;
+                } else {
+                    o[0] = r.y * step + r.x;
+                    o[1] = (r.y + r.height) * step + r.x - r.height;
+                    o[2] = (r.y + r.width) * step + r.x + r.width;
+                    o[3] = (r.y + r.width + r.height) * step + r.x + r.width - r.height;
+                }
+            }
+        }
+    }
+
+    /**
+     * Runs the cascade on the window at the position of the level.
+     * @return true If all stages passed.
+     */
+    bool evaluate(const Level& level, int x, int y) const {
+        int step = int(level.sum.step / sizeof(int));
+        const int* sum = level.sum.ptr<int>() + y * step + x;
+        const int* tilted = mTilted ? level.tilted.ptr<int>() + y * step + x : 0;
+        double norm = varianceNorm(level, x, y);
+
+        const Stage* stages = mCascade.stages();
+        const Tree* trees = mCascade.trees();
+        const Node* nodes = mCascade.nodes();
+        const float* leaves = mCascade.leaves();
+        const Feature* features = mCascade.features();
+        for (size_t s = 0; s < mCascade.stageCount(); ++s) {
+            double stageSum = 0;
+            for (int t = stages[s].firstTree; t < stages[s].firstTree + stages[s].treeCount; ++t) {
+                int idx = 0;
+                do {
+                    const Node& node = nodes[trees[t].firstNode + idx];
+                    const int* base = features[node.feature].tilted ? tilted : sum;
+                    const int* off = &mOffsets[node.feature * 3 * 4];
+                    const float* w = &mWeights[node.feature * 3];
+                    double value = (base[off[0]] - base[off[1]] - base[off[2]] + base[off[3]]) * double(w[0]) +
+                        (base[off[4]] - base[off[5]] - base[off[6]] + base[off[7]]) * double(w[1]);
+                    if (features[node.feature].count > 2) {
+                        value += (base[off[8]] - base[off[9]] - base[off[10]] + base[off[11]]) * double(w[2]);
+                    }
+                    idx = value < node.threshold * norm ? node.left : node.right;
+                } while (idx > 0);
+                stageSum += leaves[trees[t].firstLeaf - idx];
+            }
+            if (stageSum < stages[s].threshold - STAGE_THRESHOLD_BIAS) {
+                return false;
+            }
+        }
+
+        return true;
+    }
+
+    /**
+     * Standard deviation of pixels in the window without its border, used to normalize feature thresholds.
+     */
+    double varianceNorm(const Level& level, int x, int y) const {
+        int step = int(level.sum.step / sizeof(int));
+        int sqstep = int(level.sqsum.step / sizeof(double));
+        const int* sum = level.sum.ptr<int>() + y * step + x;
+        const double* sq = level.sqsum.ptr<double>() + y * sqstep + x;
+
+        // The squared integral may have another row step, shift window offsets for it.
+        const int* o = mWindowOffsets;
+        int sqo[4] = {
+            o[0] / step * sqstep + o[0] % step, o[1] / step * sqstep + o[1] % step,
+            o[2] / step * sqstep + o[2] % step, o[3] / step * sqstep + o[3] % step
+        };
+        double mean = (sum[o[0]] - sum[o[1]] - sum[o[2]] + sum[o[3]]) * mInvArea;
+        double variance = (sq[sqo[0]] - sq[sqo[1]] - sq[sqo[2]] + sq[sqo[3]]) * mInvArea - mean * mean;
+
+        return variance >= 0 ? sqrt(variance) : 1;
+    }
+
+    const Cascade& mCascade;
+    bool mTilted;
+    double mInvArea;
+
+    /**
+     * Normalized weights of rectangles, 3 per feature.
+     */
+    std::vector<float> mWeights;
+
+    /**
+     * Offsets of corners of rectangles in integrals, 4 per rectangle, 3 rectangles per feature.
+     */
+    std::vector<int> mOffsets;
+
+    /**
+     * Offsets of corners of the window without its border.
+     */
+    int mWindowOffsets[4];
+
+    /**
+     * Row step offsets were computed for.
+     */
+    int mStep;
+
+    /**
+     * Reused level of the current pass.
+     */
+    Level mLevel;
+};
+
+/**
+ * Evaluates the same cascade as Classifier, but nodes are kept as flat arrays (structure of arrays)
+ * and 4 neighboring windows of a row are evaluated at once with SSE2.
+ * Stump trees are fully vectorized, deeper trees evaluate all their nodes for 4 windows
+ * and then pick the path of each window from comparison masks.
+ * Features are computed in single precision, so results may differ from Classifier in borderline windows.
+ */
+class SimdClassifier : public Classifier {
+public:
+
+    SimdClassifier(const Cascade& cascade) : Classifier(cascade), mSimdStep(0) {
+        size_t nodes = cascade.nodeCount();
+        mThreshold.resize(nodes);
+        mLeft.resize(nodes);
+        mRight.resize(nodes);
+        mTiltedNode.resize(nodes);
+        for (int k = 0; k < 3; ++k) {
+            mWeight[k].resize(nodes);
+            for (int c = 0; c < 4; ++c) {
+                mCorner[k * 4 + c].resize(nodes);
+            }
+        }
+        for (size_t n = 0; n < nodes; ++n) {
+            const Node& node = cascade.nodes()[n];
+            mThreshold[n] = node.threshold;
+            mLeft[n] = node.left;
+            mRight[n] = node.right;
+            mTiltedNode[n] = cascade.features()[node.feature].tilted != 0;
+            for (int k = 0; k < 3; ++k) {
+                // Missing rectangles get zero weight and zero offsets, so they add nothing.
+                mWeight[k][n] = k < cascade.features()[node.feature].count ? mWeights[node.feature * 3 + k] : 0;
+            }
+        }
+
+        mTreeNodes.resize(cascade.treeCount());
+        mSimd = true;
+        for (size_t t = 0; t < cascade.treeCount(); ++t) {
+            int next = t + 1 < cascade.treeCount() ? cascade.trees()[t + 1].firstNode : int(nodes);
+            mTreeNodes[t] = next - cascade.trees()[t].firstNode;
+            if (mTreeNodes[t] < 1 || mTreeNodes[t] > MAX_TREE_NODES) {
+                mSimd = false;
+            }
+        }
+    }
+
+protected:
+
+    virtual void scan(const Level& level, const cv::Rect& area, std::vector<cv::Rect>& candidates) {
+#ifdef __SSE2__
+        if (!mSimd) {
+            Classifier::scan(level, area, candidates);
+            return;
+        }
+
+        cv::Size win0 = mCascade.window();
+        cv::Size win(cvRound(win0.width * level.factor), cvRound(win0.height * level.factor));
+        prepare(level);
+        prepareNodes(level);
+
+        int ystep = level.factor > 2 ? 1 : 2;
+        int yend = std::min(area.y + area.height, level.sum.rows - 1) - win0.height;
+        int xend = std::min(area.x + area.width, level.sum.cols - 1) - win0.width;
+        for (int y = area.y; y < yend; y += ystep) {
+            int x = area.x;
+            // Groups of 4 windows whose loads stay inside the row.
+            for (; x + 3 * ystep < xend; x += 4 * ystep) {
+                int passed = evaluate4(level, x, y, ystep);
+                for (int i = 0; i < 4; ++i) {
+                    if (passed & (1 << i)) {
+                        candidates.push_back(cv::Rect(cvRound((x + i * ystep) * level.factor), cvRound(y * level.factor),
+                            win.width, win.height));
+                    }
+                }
+            }
+            for (; x < xend; x += ystep) {
+                if (evaluate(level, x, y)) {
+                    candidates.push_back(cv::Rect(cvRound(x * level.factor), cvRound(y * level.factor),
+                        win.width, win.height));
+                }
+            }
+        }
+#else
+        Classifier::scan(level, area, candidates);
+#endif
+    }
+
+private:
+
+    /**
+     * Trees with more nodes are evaluated by Classifier.
+     */
+    static const int MAX_TREE_NODES = 32;
+
+    /**
+     * Computes offsets of corners of node rectangles for the row step of the level.
+     */
+    void prepareNodes(const Level& level) {
+        int step = int(level.sum.step / sizeof(int));
+        if (step == mSimdStep) {
+            return;
+        }
+        mSimdStep = step;
+
+        for (size_t n = 0; n < mThreshold.size(); ++n) {
+            const int* o = &mOffsets[mCascade.nodes()[n].feature * 3 * 4];
+            for (int i = 0; i < 12; ++i) {
+                mCorner[i][n] = o[i];
+            }
+        }
+    }
+
+#ifdef __SSE2__
+    /**
+     * Loads integral values at 4 windows spaced by \a dx from \a p.
+     */
+    static inline __m128i load4(const int* p, int dx) {
+        if (dx == 1) {
+            return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p));
+        }
+
+        // Even elements of 8 consecutive ones.
+        __m128 a = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        __m128 b = _mm_castsi128_ps(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 4)));
+        return _mm_castps_si128(_mm_shuffle_ps(a, b, _MM_SHUFFLE(2, 0, 2, 0)));
+    }
+
+    /**
+     * Value of the feature of node \a n for 4 windows.
+     */
+    inline __m128 feature4(size_t n, const int* base, int dx) const {
+        __m128 value = _mm_setzero_ps();
+        for (int k = 0; k < 3; ++k) {
+            __m128i s = _mm_add_epi32(
+                _mm_sub_epi32(load4(base + mCorner[k * 4][n], dx), load4(base + mCorner[k * 4 + 1][n], dx)),
+                _mm_sub_epi32(load4(base + mCorner[k * 4 + 3][n], dx), load4(base + mCorner[k * 4 + 2][n], dx)));
+            value = _mm_add_ps(value, _mm_mul_ps(_mm_cvtepi32_ps(s), _mm_set1_ps(mWeight[k][n])));
+        }
+
+        return value;
+    }
+
+    /**
+     * Runs the cascade on 4 windows at (x + i * dx, y).
+     * @return Bit i is set if window i passed all stages.
+     */
+    int evaluate4(const Level& level, int x, int y, int dx) const {
+        int step = int(level.sum.step / sizeof(int));
+        const int* sum = level.sum.ptr<int>() + y * step + x;
+        const int* tilted = mTilted ? level.tilted.ptr<int>() + y * step + x : 0;
+
+        float norms[4];
+        for (int i = 0; i < 4; ++i) {
+            norms[i] = float(varianceNorm(level, x + i * dx, y));
+        }
+        const __m128 norm = _mm_loadu_ps(norms);
+
+        const Stage* stages = mCascade.stages();
+        const Tree* trees = mCascade.trees();
+        const float* leaves = mCascade.leaves();
+        int alive = 0xF;
+        for (size_t s = 0; s < mCascade.stageCount(); ++s) {
+            __m128 stageSum = _mm_setzero_ps();
+            for (int t = stages[s].firstTree; t < stages[s].firstTree + stages[s].treeCount; ++t) {
+                int first = trees[t].firstNode;
+                const float* treeLeaves = leaves + trees[t].firstLeaf;
+                if (mTreeNodes[t] == 1) {
+                    __m128 value = feature4(first, mTiltedNode[first] ? tilted : sum, dx);
+                    __m128 lt = _mm_cmplt_ps(value, _mm_mul_ps(_mm_set1_ps(mThreshold[first]), norm));
+                    __m128 left = _mm_set1_ps(treeLeaves[-mLeft[first]]);
+                    __m128 right = _mm_set1_ps(treeLeaves[-mRight[first]]);
+                    stageSum = _mm_add_ps(stageSum, _mm_or_ps(_mm_and_ps(lt, left), _mm_andnot_ps(lt, right)));
+                    continue;
+                }
+
+                int masks[MAX_TREE_NODES];
+                for (int i = 0; i < mTreeNodes[t]; ++i) {
+                    size_t n = first + i;
+                    __m128 value = feature4(n, mTiltedNode[n] ? tilted : sum, dx);
+                    masks[i] = _mm_movemask_ps(_mm_cmplt_ps(value, _mm_mul_ps(_mm_set1_ps(mThreshold[n]), norm)));
+                }
+                float values[4];
+                for (int lane = 0; lane < 4; ++lane) {
+                    int idx = 0;
+                    do {
+                        idx = (masks[idx] >> lane) & 1 ? mLeft[first + idx] : mRight[first + idx];
+                    } while (idx > 0);
+                    values[lane] = treeLeaves[-idx];
+                }
+                stageSum = _mm_add_ps(stageSum, _mm_loadu_ps(values));
+            }
+
+            __m128 threshold = _mm_set1_ps(float(stages[s].threshold - STAGE_THRESHOLD_BIAS));
+            alive &= _mm_movemask_ps(_mm_cmpge_ps(stageSum, threshold));
+            if (!alive) {
+                return 0;
+            }
+        }
+
+        return alive;
+    }
+#endif
+
+    /**
+     * Nodes as structure of arrays, indexed like Cascade::nodes().
+     */
+    std::vector<float> mThreshold;
+    std::vector<int> mLeft;
+    std::vector<int> mRight;
+    std::vector<char> mTiltedNode;
+    std::vector<float> mWeight[3];
+
+    /**
+     * Offsets of 4 corners of 3 rectangles of every node.
+     */
+    std::vector<int> mCorner[12];
+
+    /**
+     * Number of nodes in every tree.
+     */
+    std::vector<int> mTreeNodes;
+
+    /**
+     * False if some tree is too deep for the vectorized path.
+     */
+    bool mSimd;
+
+    /**
+     * Row step corners were computed for.
+     */
+    int mSimdStep;
+};
+
+/**
+ * Evaluates a cascade that was turned into C++ by cascadegen.
+ * \a Model provides HASH of the cascade it was generated from and
+ * static bool evaluate(const int* sum, const int* tilted, int step, double norm) with all stages unrolled.
+ */
+template<typename Model>
+class CompiledClassifier : public Classifier {
+public:
+
+    CompiledClassifier(const Cascade& cascade) : Classifier(cascade) {}
+
+protected:
+
+    virtual void scan(const Level& level, const cv::Rect& area, std::vector<cv::Rect>& candidates) {
+        cv::Size win0 = mCascade.window();
+        cv::Size win(cvRound(win0.width * level.factor), cvRound(win0.height * level.factor));
+        prepare(level);
+
+        int step = int(level.sum.step / sizeof(int));
+        int ystep = level.factor > 2 ? 1 : 2;
+        int yend = std::min(area.y + area.height, level.sum.rows - 1) - win0.height;
+        int xend = std::min(area.x + area.width, level.sum.cols - 1) - win0.width;
+        for (int y = area.y; y < yend; y += ystep) {
+            const int* sum = level.sum.ptr<int>(y);
+            const int* tilted = mTilted ? level.tilted.ptr<int>(y) : 0;
+            for (int x = area.x; x < xend; x += ystep) {
+                if (Model::evaluate(sum + x, tilted ? tilted + x : 0, step, varianceNorm(level, x, y))) {
+                    candidates.push_back(cv::Rect(cvRound(x * level.factor), cvRound(y * level.factor),
+                        win.width, win.height));
+                }
+            }
+        }
+    }
+};
+
+} // namespace haar
+
+#endif
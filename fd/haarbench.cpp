@@ -0,0 +1,151 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Command line application that compares throughput of Haar cascade evaluators on a directory of images:
+ * OpenCV CascadeClassifier, scalar haar::Classifier, SSE2 haar::SimdClassifier
+ * and the code generated by cascadegen if the cascade is a bundled one.
+ */
+
+#include "compiled.h"
+#include "haar.h"
+#include "walker.h"
+
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+void showHelp(const char *appName) {
+    cerr << "Compares Haar cascade evaluators.\n" <<
+        "Usage: " << appName << " cascade.xml directory [repeats]\n" <<
+        "Using OpenCV version " << CV_VERSION << "\n";
+}
+
+/**
+ * Timing and results of one evaluator.
+ */
+struct Result {
+    const char* name;
+    double ms;
+    size_t objects;
+    size_t matched;
+};
+
+/**
+ * Intersection over union at which two detections are the same object.
+ * Evaluators differ in rounding of scaled windows and in floating point sums, so the same object
+ * may come a pixel or two apart; different objects barely overlap.
+ */
+const double SAME_OBJECT = 0.5;
+
+/**
+ * @return Intersection over union of two rectangles.
+ */
+double overlap(const Rect& a, const Rect& b) {
+    double intersection = (a & b).area();
+
+    return intersection > 0 ? intersection / (a.area() + b.area() - intersection) : 0;
+}
+
+/**
+ * @return Number of rectangles of \a a that are the same objects as rectangles of \a b,
+ * each rectangle of \a b is matched once.
+ */
+size_t common(const vector<Rect>& a, const vector<Rect>& b) {
+    size_t result = 0;
+    vector<bool> used(b.size(), false);
+    for (size_t i = 0; i < a.size(); ++i) {
+        size_t best = b.size();
+        double bestOverlap = SAME_OBJECT;
+        for (size_t j = 0; j < b.size(); ++j) {
+            double o = overlap(a[i], b[j]);
+            if (!used[j] && o >= bestOverlap) {
+                best = j;
+                bestOverlap = o;
+            }
+        }
+        if (best < b.size()) {
+            used[best] = true;
+            ++result;
+        }
+    }
+
+    return result;
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 3) {
+        showHelp(argv[0]);
+        return 1;
+    }
+    int repeats = argc > 3 ? atoi(argv[3]) : 3;
+    if (repeats < 1) {
+        repeats = 1;
+    }
+
+    CascadeClassifier opencv;
+    haar::Cascade cascade;
+    if (!opencv.load(argv[1]) || !cascade.load(argv[1])) {
+        cerr << "Couldn't load cascade " << argv[1] << endl;
+        return 1;
+    }
+    haar::Classifier scalar(cascade);
+    haar::SimdClassifier simd(cascade);
+    haar::Classifier* compiled = haar::compiled::create(cascade);
+    int evaluators = compiled ? 4 : 3;
+
+    vector<Mat> images;
+    Walker walker;
+    walker.walk(argv[2], [&images](const string& path, const char*) {
+        Mat image = imread(path, CV_LOAD_IMAGE_GRAYSCALE);
+        if (image.data) {
+            equalizeHist(image, image);
+            images.push_back(image);
+        }
+    });
+    if (images.empty()) {
+        cerr << "No images in " << argv[2] << endl;
+        return 1;
+    }
+
+    Result results[4] = {{"opencv", 0, 0, 0}, {"scalar", 0, 0, 0}, {"simd", 0, 0, 0}, {"compiled", 0, 0, 0}};
+    for (size_t i = 0; i < images.size(); ++i) {
+        vector<Rect> objects[4];
+        for (int r = 0; r < repeats; ++r) {
+            for (int k = 0; k < evaluators; ++k) {
+                int64 start = getTickCount();
+                if (k == 0) {
+                    opencv.detectMultiScale(images[i], objects[k], 1.1, 2, CV_HAAR_SCALE_IMAGE, Size(30, 30));
+                } else if (k == 1) {
+                    scalar.detectMultiScale(images[i], objects[k], 1.1, 2, Size(30, 30));
+                } else if (k == 2) {
+                    simd.detectMultiScale(images[i], objects[k], 1.1, 2, Size(30, 30));
+                } else {
+                    compiled->detectMultiScale(images[i], objects[k], 1.1, 2, Size(30, 30));
+                }
+                results[k].ms += (getTickCount() - start) * 1000. / getTickFrequency();
+            }
+        }
+        for (int k = 0; k < evaluators; ++k) {
+            results[k].objects += objects[k].size();
+            results[k].matched += common(objects[k], objects[0]);
+        }
+    }
+
+    cout << images.size() << " images, " << repeats << " repeats" << endl;
+    for (int k = 0; k < evaluators; ++k) {
+        double perImage = results[k].ms / (images.size() * repeats);
+        cout << results[k].name << ": " << perImage << " ms/image, " << 1000. / perImage << " images/s, " <<
+            results[k].objects << " objects, " << results[k].matched << " same as opencv, x" <<
+            results[0].ms / results[k].ms << endl;
+    }
+    if (!compiled) {
+        cout << "compiled: no generated code for " << argv[1] << endl;
+    }
+    delete compiled;
+
+    return 0;
+}
@@ -0,0 +1,295 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Parity of the Haar cascade evaluators of haar.h with OpenCV CascadeClassifier on a directory of images.
+ * Candidate windows of all built-in evaluators (scalar, SSE2, generated code, pyramid levels, the cascade
+ * saved to the binary format and loaded back) must be the same. OpenCV differs in rounding of scaled
+ * windows, so its candidates must mostly be the same and its grouped objects must be the same objects.
+ * Damaged binary cascades must not load. The fused grayscale equalization of fd must give what OpenCV does.
+ */
+
+#include "../common/check.h"
+#include "compiled.h"
+#include "gray.h"
+#include "haar.h"
+#include "walker.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+
+using namespace cv;
+using namespace std;
+
+/**
+ * Part of candidate windows of OpenCV and of haar.h in all images that must be exactly the same.
+ * Evaluators differ in rounding of scaled windows, so a few windows at the edge of an object
+ * are found by one of them only.
+ */
+const double SAME_CANDIDATES = 0.85;
+
+/**
+ * Intersection over union at which two detections are the same object, like in haarbench.
+ */
+const double SAME_OBJECT = 0.5;
+
+bool before(const Rect& a, const Rect& b) {
+    if (a.x != b.x) {
+        return a.x < b.x;
+    }
+    if (a.y != b.y) {
+        return a.y < b.y;
+    }
+    if (a.width != b.width) {
+        return a.width < b.width;
+    }
+
+    return a.height < b.height;
+}
+
+vector<Rect> sorted(vector<Rect> rects) {
+    sort(rects.begin(), rects.end(), before);
+
+    return rects;
+}
+
+/**
+ * @return Number of rectangles exactly in both.
+ */
+size_t exact(const vector<Rect>& a, const vector<Rect>& b) {
+    vector<Rect> sa = sorted(a);
+    vector<Rect> sb = sorted(b);
+    vector<Rect> both;
+    set_intersection(sa.begin(), sa.end(), sb.begin(), sb.end(), back_inserter(both), before);
+
+    return both.size();
+}
+
+double overlap(const Rect& a, const Rect& b) {
+    double intersection = (a & b).area();
+
+    return intersection > 0 ? intersection / (a.area() + b.area() - intersection) : 0;
+}
+
+/**
+ * @return Number of rectangles of \a a that are the same objects as rectangles of \a b,
+ * each rectangle of \a b is matched once.
+ */
+size_t common(const vector<Rect>& a, const vector<Rect>& b) {
+    size_t result = 0;
+    vector<bool> used(b.size(), false);
+    for (size_t i = 0; i < a.size(); ++i) {
+        for (size_t j = 0; j < b.size(); ++j) {
+            if (!used[j] && overlap(a[i], b[j]) >= SAME_OBJECT) {
+                used[j] = true;
+                ++result;
+                break;
+            }
+        }
+    }
+
+    return result;
+}
+
+/**
+ * Small valid cascade in the binary format: one stage of one tree of three nodes,
+ * an upright and a tilted feature in a 24x24 window.
+ */
+struct TinyCascade {
+    haar::FileHeader header;
+    haar::Stage stage;
+    haar::Tree tree;
+    haar::Node nodes[3];
+    float leaves[4];
+    haar::Feature features[2];
+
+    TinyCascade() {
+        memset(this, 0, sizeof(*this));
+        memcpy(header.magic, haar::MAGIC, sizeof(haar::MAGIC));
+        header.version = haar::VERSION;
+        header.width = 24;
+        header.height = 24;
+        header.stages = 1;
+        header.trees = 1;
+        header.nodes = 3;
+        header.leaves = 4;
+        header.features = 2;
+        stage.treeCount = 1;
+        haar::Node n[3] = {{0, 0, 1, 2}, {1, 0, 0, -1}, {0, 0, -2, -3}};
+        memcpy(nodes, n, sizeof(n));
+        haar::FeatureRect upright[2] = {{0, 0, 24, 24, -1}, {0, 0, 12, 24, 2}};
+        memcpy(features[0].rect, upright, sizeof(upright));
+        features[0].count = 2;
+        haar::FeatureRect tilted = {12, 0, 6, 6, 1};
+        features[1].rect[0] = tilted;
+        features[1].count = 1;
+        features[1].tilted = 1;
+    }
+
+    bool load(const string& path) const {
+        {
+            ofstream out(path.c_str(), ios::binary);
+            out.write(reinterpret_cast<const char*>(this), sizeof(*this));
+        }
+        haar::Cascade cascade;
+
+        return cascade.load(path);
+    }
+};
+
+/**
+ * Damaged binary cascades must be rejected, walks through trees must end and rectangles must stay inside.
+ */
+void testDamaged(const string& dir) {
+    string path = dir + "/damaged.bin";
+    CHECK(TinyCascade().load(path));
+
+    TinyCascade c;
+    c.nodes[1].left = 1;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.nodes[2].left = 1;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.nodes[0].right = 3;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.nodes[2].right = -4;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.nodes[2].right = 0x80000000;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.nodes[0].feature = 2;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.tree.firstNode = 3;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.tree.firstLeaf = 4;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.stage.firstTree = 1;
+    c.stage.treeCount = 0x7fffffff;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.stage.treeCount = 2;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.features[0].rect[1].width = 25;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.features[0].rect[0].y = -1;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.features[0].rect[1].x = 0x7fffffff;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.features[1].rect[0].height = 13;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.features[1].rect[0].width = 13;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.features[1].count = 4;
+    CHECK(!c.load(path));
+    c = TinyCascade();
+    c.header.nodes = 4;
+    CHECK(!c.load(path));
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 4) {
+        cerr << "Usage: " << argv[0] << " cascade.xml directory directory-for-temporary-files" << endl;
+        return 1;
+    }
+    testDamaged(argv[3]);
+
+    CascadeClassifier opencv;
+    haar::Cascade cascade;
+    if (!opencv.load(argv[1]) || !cascade.load(argv[1])) {
+        cerr << "Couldn't load cascade " << argv[1] << endl;
+        return 1;
+    }
+    string binaryPath = string(argv[3]) + "/cascade.bin";
+    haar::Cascade binary;
+    if (!CHECK(cascade.save(binaryPath)) || !CHECK(binary.load(binaryPath))) {
+        return check::report("haartest");
+    }
+
+    haar::Classifier scalar(cascade);
+    haar::SimdClassifier simd(cascade);
+    haar::Classifier fromBinary(binary);
+    haar::Classifier* compiled = haar::compiled::create(cascade);
+    if (!compiled) {
+        cout << "compiled: no generated code for " << argv[1] << endl;
+    }
+
+    size_t images = 0;
+    size_t candidates = 0;
+    size_t sameCandidates = 0;
+    size_t objects = 0;
+    Walker walker;
+    walker.walk(argv[2], [&](const string& path, const char*) {
+        Mat gray = imread(path, CV_LOAD_IMAGE_GRAYSCALE);
+        if (!gray.data) {
+            return;
+        }
+        equalizeHist(gray, gray);
+        ++images;
+
+        // Also a view whose rows are not contiguous and whose width leaves a tail after 32 pixel blocks.
+        Mat color = imread(path, CV_LOAD_IMAGE_COLOR);
+        Mat views[2] = {color, color(Rect(1, 0, color.cols - 6, color.rows))};
+        for (int v = 0; v < 2; ++v) {
+            Mat expected;
+            Mat fused;
+            cvtColor(views[v], expected, CV_BGR2GRAY);
+            equalizeHist(expected, expected);
+            equalizedGray(views[v], fused);
+            CHECK(fused.size() == expected.size() && norm(fused, expected, NORM_INF) == 0);
+        }
+
+        vector<Rect> reference;
+        vector<Rect> other;
+        scalar.detectMultiScale(gray, reference, 1.1, 0, Size(30, 30));
+        reference = sorted(reference);
+        simd.detectMultiScale(gray, other, 1.1, 0, Size(30, 30));
+        CHECK(sorted(other) == reference);
+        fromBinary.detectMultiScale(gray, other, 1.1, 0, Size(30, 30));
+        CHECK(sorted(other) == reference);
+        if (compiled) {
+            compiled->detectMultiScale(gray, other, 1.1, 0, Size(30, 30));
+            CHECK(sorted(other) == reference);
+        }
+        haar::Pyramid pyramid;
+        pyramid.reset(gray, 1.1);
+        simd.detectMultiScale(pyramid, Rect(0, 0, gray.cols, gray.rows), other, 0, Size(30, 30));
+        CHECK(sorted(other) == reference);
+
+        vector<Rect> windows;
+        opencv.detectMultiScale(gray, windows, 1.1, 0, CV_HAAR_SCALE_IMAGE, Size(30, 30));
+        candidates += max(windows.size(), reference.size());
+        sameCandidates += exact(windows, reference);
+
+        vector<Rect> found;
+        opencv.detectMultiScale(gray, found, 1.1, 2, CV_HAAR_SCALE_IMAGE, Size(30, 30));
+        scalar.detectMultiScale(gray, other, 1.1, 2, Size(30, 30));
+        objects += found.size();
+        if (!CHECK(found.size() == other.size() && common(other, found) == found.size())) {
+            cerr << path << ": " << found.size() << " opencv objects, " << other.size() << " built-in" << endl;
+        }
+    });
+    delete compiled;
+
+    cout << images << " images, " << candidates << " candidates, " << sameCandidates << " same as opencv, " <<
+        objects << " objects" << endl;
+    CHECK(images > 0 && candidates > 0 && objects > 0);
+    CHECK(sameCandidates >= SAME_CANDIDATES * candidates);
+
+    return check::report("haartest");
+}
@@ -0,0 +1,136 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Regions of a video that changed, so static areas are not searched again.
+ */
+
+#ifndef SULPRE_FD_MOTION_H
+#define SULPRE_FD_MOTION_H
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * Compares every frame with a running average of previous ones on a downscaled grayscale copy.
+ * Pixels that differ by more than a threshold are dilated into blobs, and bounding boxes of blobs
+ * are padded and merged while they overlap, so a face that moves is inside one region.
+ */
+class Motion {
+public:
+
+    /**
+     * @param How fast the background follows the scene, 0..1
+     * @param Minimum change of a pixel brightness to count as motion
+     */
+    Motion(double rate = 0.05, int threshold = 25) : mRate(rate), mThreshold(threshold), mActivity(1) {}
+
+    /**
+     * Finds regions changed since previous frames and adds the frame to the background.
+     * The first frame is changed entirely.
+     * @param BGR or grayscale frame
+     * @param Pixels added around every region
+     * @return Regions in coordinates of the frame, do not overlap.
+     */
+    const std::vector<cv::Rect>& update(const cv::Mat& frame, int pad) {
+        cv::Rect whole(0, 0, frame.cols, frame.rows);
+        mRegions.clear();
+
+        // Motion of faces is visible on small copies too.
+        cv::resize(frame, mSmall, cv::Size((frame.cols + SCALE - 1) / SCALE, (frame.rows + SCALE - 1) / SCALE), 0, 0,
+            cv::INTER_AREA);
+        if (mSmall.channels() > 1) {
+            cv::cvtColor(mSmall, mGray, mSmall.channels() == 4 ? CV_BGRA2GRAY : CV_BGR2GRAY);
+        } else {
+            mSmall.copyTo(mGray);
+        }
+        if (mBackground.empty() || mBackground.size() != mGray.size()) {
+            mGray.convertTo(mBackground, CV_32F);
+            mRegions.push_back(whole);
+            mActivity = 1;
+            return mRegions;
+        }
+
+        mBackground.convertTo(mBackground8, CV_8U);
+        cv::absdiff(mGray, mBackground8, mMask);
+        cv::threshold(mMask, mMask, mThreshold, 255, CV_THRESH_BINARY);
+        cv::dilate(mMask, mMask, cv::Mat(), cv::Point(-1, -1), 2);
+        cv::accumulateWeighted(mGray, mBackground, mRate);
+
+        cv::findContours(mMask, mContours, CV_RETR_EXTERNAL, CV_CHAIN_APPROX_SIMPLE);
+        for (size_t i = 0; i < mContours.size(); ++i) {
+            cv::Rect r = cv::boundingRect(mContours[i]);
+            r = cv::Rect(r.x * SCALE - pad, r.y * SCALE - pad, r.width * SCALE + 2 * pad, r.height * SCALE + 2 * pad);
+            mRegions.push_back(r & whole);
+        }
+        merge(mRegions);
+
+        double area = 0;
+        for (size_t i = 0; i < mRegions.size(); ++i) {
+            area += mRegions[i].area();
+        }
+        mActivity = whole.area() > 0 ? area / whole.area() : 0;
+
+        return mRegions;
+    }
+
+    /**
+     * @return Part of the last frame covered by regions, 0..1.
+     */
+    double activity() const {
+        return mActivity;
+    }
+
+    /**
+     * Replaces overlapping regions by their bounding box until none overlap.
+     */
+    static void merge(std::vector<cv::Rect>& regions) {
+        bool merged = true;
+        while (merged) {
+            merged = false;
+            for (size_t i = 0; i < regions.size() && !merged; ++i) {
+                for (size_t j = i + 1; j < regions.size(); ++j) {
+                    if ((regions[i] & regions[j]).area() > 0) {
+                        regions[i] = regions[i] | regions[j];
+                        regions.erase(regions.begin() + j);
+                        merged = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+
+private:
+
+    /**
+     * Frames are compared on copies that many times smaller.
+     */
+    static const int SCALE = 4;
+
+    double mRate;
+    int mThreshold;
+    double mActivity;
+
+    /**
+     * Running average of downscaled grayscale frames.
+     */
+    cv::Mat mBackground;
+
+    /**
+     * Buffers reused between frames.
+     */
+    cv::Mat mSmall;
+    cv::Mat mGray;
+    cv::Mat mBackground8;
+    cv::Mat mMask;
+    std::vector<std::vector<cv::Point> > mContours;
+    std::vector<cv::Rect> mRegions;
+};
+
+#endif
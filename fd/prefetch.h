@@ -0,0 +1,68 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Asks the kernel to read files ahead of time.
+ */
+
+#ifndef SULPRE_FD_PREFETCH_H
+#define SULPRE_FD_PREFETCH_H
+
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * Starts asynchronous reading of whole files into the page cache,
+ * so a later decode finds the bytes already in memory instead of waiting for the storage.
+ */
+class Prefetcher {
+public:
+
+    Prefetcher() : mFiles(0), mBytes(0) {}
+
+    /**
+     * Starts reading the file and returns without waiting for it.
+     * @return false If could not open.
+     */
+    bool prefetch(const std::string& path) {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            return false;
+        }
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && st.st_size > 0) {
+            posix_fadvise(fd, 0, st.st_size, POSIX_FADV_WILLNEED);
+            ++mFiles;
+            mBytes += st.st_size;
+        }
+        close(fd);
+
+        return true;
+    }
+
+    /**
+     * Number of prefetched files.
+     */
+    size_t files() const {
+        return mFiles;
+    }
+
+    /**
+     * Number of prefetched bytes.
+     */
+    unsigned long long bytes() const {
+        return mBytes;
+    }
+
+private:
+
+    size_t mFiles;
+    unsigned long long mBytes;
+};
+
+#endif
@@ -0,0 +1,215 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Bounded lock-free queue to connect stages of processing.
+ */
+
+#ifndef SULPRE_FD_QUEUE_H
+#define SULPRE_FD_QUEUE_H
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/**
+ * Counters of a queue to see which stage waits for which.
+ */
+struct QueueStats {
+    /**
+     * Number of items went through.
+     */
+    size_t items;
+
+    /**
+     * How many times a producer found the queue full and had to wait.
+     */
+    size_t pushStalls;
+
+    /**
+     * How many times a consumer found the queue empty and had to wait.
+     */
+    size_t popStalls;
+
+    /**
+     * Average number of items in the queue seen by producers.
+     */
+    double occupancy;
+};
+
+/**
+ * Multi-producer multi-consumer bounded queue based on a ring of sequenced cells.
+ * Push and pop never take a lock; they spin and then sleep briefly while the queue is full or empty.
+ * The queue is closed when the last producer leaves, consumers then drain it and stop.
+ */
+template<typename T>
+class BoundedQueue {
+public:
+
+    /**
+     * @param Minimum capacity, rounded up to a power of two.
+     * @param Number of producers that will call leave().
+     */
+    BoundedQueue(size_t capacity, size_t producers)
+        : mCells(roundUp(capacity)), mMask(mCells.size() - 1), mPushPos(0), mPopPos(0),
+        mProducers(producers), mItems(0), mPushStalls(0), mPopStalls(0), mOccupancy(0) {
+        for (size_t i = 0; i < mCells.size(); ++i) {
+            mCells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+    }
+
+    /**
+     * Adds an item, waits while the queue is full.
+     */
+    void push(T item) {
+        bool stalled = false;
+        for (unsigned spins = 0; !tryPush(item); ++spins) {
+            if (!stalled) {
+                stalled = true;
+                ++mPushStalls;
+            }
+            backoff(spins);
+        }
+    }
+
+    /**
+     * Takes an item, waits while the queue is empty.
+     * @return false If the queue is empty and all producers left.
+     */
+    bool pop(T& item) {
+        bool stalled = false;
+        for (unsigned spins = 0; !tryPop(item); ++spins) {
+            if (mProducers.load(std::memory_order_acquire) == 0) {
+                // Something could be pushed right before the last producer left.
+                return tryPop(item);
+            }
+            if (!stalled) {
+                stalled = true;
+                ++mPopStalls;
+            }
+            backoff(spins);
+        }
+
+        return true;
+    }
+
+    /**
+     * Called by a producer that will not push anymore.
+     */
+    void leave() {
+        mProducers.fetch_sub(1, std::memory_order_release);
+    }
+
+    /**
+     * Approximate number of items in the queue.
+     */
+    size_t size() const {
+        size_t push = mPushPos.load(std::memory_order_relaxed);
+        size_t pop = mPopPos.load(std::memory_order_relaxed);
+        return push > pop ? push - pop : 0;
+    }
+
+    size_t capacity() const {
+        return mCells.size();
+    }
+
+    QueueStats stats() const {
+        QueueStats s;
+        s.items = mItems;
+        s.pushStalls = mPushStalls;
+        s.popStalls = mPopStalls;
+        s.occupancy = s.items ? double(mOccupancy) / s.items : 0;
+        return s;
+    }
+
+private:
+
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    bool tryPush(T& item) {
+        size_t pos = mPushPos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &mCells[pos & mMask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t dif = ptrdiff_t(seq) - ptrdiff_t(pos);
+            if (dif == 0) {
+                if (mPushPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = mPushPos.load(std::memory_order_relaxed);
+            }
+        }
+
+        mOccupancy += size();
+        ++mItems;
+        cell->data = std::move(item);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    bool tryPop(T& item) {
+        size_t pos = mPopPos.load(std::memory_order_relaxed);
+        Cell* cell;
+        for (;;) {
+            cell = &mCells[pos & mMask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t dif = ptrdiff_t(seq) - ptrdiff_t(pos + 1);
+            if (dif == 0) {
+                if (mPopPos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+                    break;
+                }
+            } else if (dif < 0) {
+                return false;
+            } else {
+                pos = mPopPos.load(std::memory_order_relaxed);
+            }
+        }
+
+        item = std::move(cell->data);
+        cell->data = T();
+        cell->sequence.store(pos + mMask + 1, std::memory_order_release);
+
+        return true;
+    }
+
+    static void backoff(unsigned spins) {
+        if (spins < 64) {
+            std::this_thread::yield();
+        } else {
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+        }
+    }
+
+    static size_t roundUp(size_t n) {
+        size_t r = 2;
+        while (r < n) {
+            r <<= 1;
+        }
+        return r;
+    }
+
+    std::vector<Cell> mCells;
+    size_t mMask;
+    std::atomic<size_t> mPushPos;
+    std::atomic<size_t> mPopPos;
+    std::atomic<size_t> mProducers;
+    std::atomic<size_t> mItems;
+    std::atomic<size_t> mPushStalls;
+    std::atomic<size_t> mPopStalls;
+    std::atomic<size_t> mOccupancy;
+};
+
+#endif
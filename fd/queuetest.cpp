@@ -0,0 +1,185 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Stress test of BoundedQueue: many producers and consumers pass numbered items through small queues.
+ * Every item must come out exactly once, items of one producer in the order they were pushed
+ * as seen by any consumer, and consumers must stop only after the queue is drained.
+ */
+
+#include "../common/check.h"
+#include "queue.h"
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+/**
+ * Item of a producer, move-only so a copy instead of a move does not compile.
+ */
+typedef unique_ptr<size_t> Item;
+
+/**
+ * Items are numbered producer * ITEMS + sequence.
+ */
+const size_t ITEMS = 20000;
+
+/**
+ * @param Number of items each producer pushes, at most ITEMS.
+ * @param Whether to print counters of the queue.
+ */
+void stress(size_t producers, size_t consumers, size_t capacity, size_t items = ITEMS, bool verbose = true) {
+    BoundedQueue<Item> queue(capacity, producers);
+    vector<atomic<unsigned char> > seen(producers * ITEMS);
+    for (size_t i = 0; i < seen.size(); ++i) {
+        seen[i].store(0);
+    }
+    atomic<size_t> popped(0);
+    atomic<size_t> nulls(0);
+    atomic<size_t> disordered(0);
+
+    vector<thread> threads;
+    for (size_t c = 0; c < consumers; ++c) {
+        threads.push_back(thread([&]() {
+            vector<size_t> last(producers, 0);
+            vector<bool> any(producers, false);
+            Item item;
+            while (queue.pop(item)) {
+                if (!item) {
+                    ++nulls;
+                    continue;
+                }
+                size_t producer = *item / ITEMS;
+                size_t sequence = *item % ITEMS;
+                if (any[producer] && sequence <= last[producer]) {
+                    ++disordered;
+                }
+                any[producer] = true;
+                last[producer] = sequence;
+                ++seen[*item];
+                ++popped;
+            }
+        }));
+    }
+    for (size_t p = 0; p < producers; ++p) {
+        threads.push_back(thread([&queue, p, items]() {
+            for (size_t i = 0; i < items; ++i) {
+                queue.push(Item(new size_t(p * ITEMS + i)));
+            }
+            queue.leave();
+        }));
+    }
+    for (size_t i = 0; i < threads.size(); ++i) {
+        threads[i].join();
+    }
+
+    size_t missing = 0;
+    size_t duplicated = 0;
+    for (size_t i = 0; i < seen.size(); ++i) {
+        missing += seen[i] == 0 && i % ITEMS < items;
+        duplicated += seen[i] > 1;
+    }
+    QueueStats stats = queue.stats();
+    if (verbose) {
+        cout << producers << " producers, " << consumers << " consumers, capacity " << queue.capacity() << ": " <<
+            stats.pushStalls << " push stalls, " << stats.popStalls << " pop stalls, occupancy " << stats.occupancy << endl;
+    }
+    CHECK(popped == producers * items);
+    CHECK(missing == 0);
+    CHECK(duplicated == 0);
+    CHECK(nulls == 0);
+    CHECK(disordered == 0);
+    CHECK(stats.items == producers * items);
+    CHECK(stats.occupancy <= queue.capacity());
+    CHECK(queue.size() == 0);
+
+    Item item;
+    CHECK(!queue.pop(item));
+}
+
+/**
+ * Consumers are already waiting when all producers push their items at once and leave right after,
+ * so the queue closes while consumers are between an empty pop and the check for producers.
+ * Every item must still come out exactly once.
+ */
+void drain(size_t producers, size_t consumers, size_t items, int rounds) {
+    size_t lost = 0;
+    size_t duplicated = 0;
+    for (int round = 0; round < rounds; ++round) {
+        BoundedQueue<Item> queue(producers * items, producers);
+        vector<atomic<unsigned char> > seen(producers * items);
+        for (size_t i = 0; i < seen.size(); ++i) {
+            seen[i].store(0);
+        }
+        atomic<size_t> waiting(0);
+        atomic<bool> start(false);
+
+        vector<thread> threads;
+        for (size_t c = 0; c < consumers; ++c) {
+            threads.push_back(thread([&]() {
+                ++waiting;
+                Item item;
+                while (queue.pop(item)) {
+                    ++seen[*item];
+                }
+            }));
+        }
+        for (size_t p = 0; p < producers; ++p) {
+            threads.push_back(thread([&queue, &start, p, items]() {
+                while (!start) {
+                    this_thread::yield();
+                }
+                for (size_t i = 0; i < items; ++i) {
+                    queue.push(Item(new size_t(p * items + i)));
+                }
+                queue.leave();
+            }));
+        }
+        while (waiting < consumers) {
+            this_thread::yield();
+        }
+        start = true;
+        for (size_t i = 0; i < threads.size(); ++i) {
+            threads[i].join();
+        }
+
+        for (size_t i = 0; i < seen.size(); ++i) {
+            lost += seen[i] == 0;
+            duplicated += seen[i] > 1;
+        }
+    }
+
+    cout << "drain: " << producers << " producers, " << consumers << " consumers, " << rounds << " rounds: " <<
+        lost << " lost, " << duplicated << " duplicated" << endl;
+    CHECK(lost == 0);
+    CHECK(duplicated == 0);
+}
+
+int main() {
+    // Queues much smaller than the number of items keep producers and consumers waiting for each other.
+    stress(1, 1, 2);
+    stress(1, 4, 4);
+    stress(4, 1, 4);
+    stress(4, 4, 2);
+    stress(8, 3, 16);
+    stress(3, 8, 64);
+
+    // Producers leave right after their last item while consumers wait, the last items must not be lost.
+    for (int round = 0; round < 1000; ++round) {
+        stress(2, 2, 2, 1 + round % 3, false);
+    }
+    drain(4, 4, 1, 500);
+    drain(8, 8, 3, 300);
+
+    // A queue without producers is closed right away.
+    BoundedQueue<Item> closed(4, 0);
+    Item item;
+    CHECK(!closed.pop(item));
+
+    return check::report("queuetest");
+}
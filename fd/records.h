@@ -0,0 +1,241 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Detection results written as records instead of annotated images.
+ */
+
+#ifndef SULPRE_FD_RECORDS_H
+#define SULPRE_FD_RECORDS_H
+
+#include "opencv2/core/core.hpp"
+
+#include <atomic>
+#include <cerrno>
+#include <cstdio>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/**
+ * Writes a record per image to a file or stdout, shared by all workers.
+ * Records are collected in a buffer and written by large chunks. A full buffer is swapped
+ * with a spare one and written without blocking workers that add records meanwhile.
+ * After the first failed write no more records are taken, the failure is reported by close().
+ *
+ * JSON Lines, one object per line:
+ * {"path":"a/b.jpg","faces":[[x,y,w,h],...],"eyes":[[x,y,w,h],...]}
+ *
+ * Binary, native byte order, all numbers are 4 bytes:
+ * path-length path faces-count x y w h ... eyes-count x y w h ...
+ */
+class RecordWriter {
+public:
+
+    enum Format {
+        JSON,
+        BINARY
+    };
+
+    RecordWriter() : mFd(-1), mFormat(JSON), mFailed(false), mRecords(0), mBytes(0) {}
+
+    ~RecordWriter() {
+        close();
+    }
+
+    /**
+     * @param Filename, "-" for stdout
+     * @return false If could not open.
+     */
+    bool open(const std::string& filename, Format format) {
+        close();
+        mFormat = format;
+        mFailed = false;
+        mFd = filename == "-" ? STDOUT_FILENO : ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        mBuffer.reserve(BUFFER_SIZE + 4096);
+        mWriting.reserve(BUFFER_SIZE + 4096);
+
+        return mFd >= 0;
+    }
+
+    /**
+     * Writes what is buffered and closes the file.
+     * @return false If could not write this or any earlier record.
+     */
+    bool close() {
+        std::lock_guard<std::mutex> lock(mMutex);
+        if (mFd < 0) {
+            return true;
+        }
+
+        std::lock_guard<std::mutex> writing(mWriteMutex);
+        take();
+        bool result = flush();
+        mBuffer.clear();
+        mWriting.clear();
+        if (mFd != STDOUT_FILENO) {
+            result = ::close(mFd) == 0 && result;
+        }
+        mFd = -1;
+
+        return result;
+    }
+
+    /**
+     * Adds a record of the image, may be called from many threads.
+     * @return false If could not write, the record is dropped then.
+     */
+    bool write(const std::string& path, const std::vector<cv::Rect>& faces, const std::vector<cv::Rect>& eyes) {
+        std::unique_lock<std::mutex> lock(mMutex);
+        if (mFailed) {
+            return false;
+        }
+        if (mFormat == JSON) {
+            mBuffer += "{\"path\":\"";
+            escape(path);
+            mBuffer += "\",\"faces\":";
+            json(faces);
+            mBuffer += ",\"eyes\":";
+            json(eyes);
+            mBuffer += "}\n";
+        } else {
+            number(uint32_t(path.size()));
+            mBuffer += path;
+            binary(faces);
+            binary(eyes);
+        }
+        ++mRecords;
+        if (mBuffer.size() < BUFFER_SIZE) {
+            return true;
+        }
+
+        // If another thread is writing, the buffer keeps growing and is written with a later record.
+        std::unique_lock<std::mutex> writing(mWriteMutex, std::try_to_lock);
+        if (!writing.owns_lock()) {
+            return true;
+        }
+        take();
+        lock.unlock();
+
+        return flush();
+    }
+
+    void report(std::ostream& out) const {
+        std::lock_guard<std::mutex> lock(mMutex);
+        std::lock_guard<std::mutex> writing(mWriteMutex);
+        out << "records: " << mRecords << " records, " << mBytes << " bytes" << std::endl;
+    }
+
+private:
+
+    /**
+     * Buffered bytes are written when there are that many.
+     */
+    static const size_t BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * Moves buffered records behind what is left to write, under both mutexes.
+     */
+    void take() {
+        if (mWriting.empty()) {
+            mWriting.swap(mBuffer);
+        } else {
+            mWriting += mBuffer;
+            mBuffer.clear();
+        }
+    }
+
+    /**
+     * Writes taken records under the write mutex only.
+     * On failure the rest is dropped, so records don't pile up in memory while none can be written.
+     */
+    bool flush() {
+        size_t done = 0;
+        while (!mFailed && done < mWriting.size()) {
+            ssize_t n = ::write(mFd, mWriting.data() + done, mWriting.size() - done);
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            if (n <= 0) {
+                mFailed = true;
+                break;
+            }
+            done += n;
+        }
+        mBytes += done;
+        mWriting.clear();
+
+        return !mFailed;
+    }
+
+    void escape(const std::string& s) {
+        for (size_t i = 0; i < s.size(); ++i) {
+            unsigned char c = s[i];
+            if (c == '"' || c == '\\') {
+                mBuffer += '\\';
+                mBuffer += char(c);
+            } else if (c < 0x20) {
+                char buf[8];
+                snprintf(buf, sizeof(buf), "\\u%04x", c);
+                mBuffer += buf;
+            } else {
+                mBuffer += char(c);
+            }
+        }
+    }
+
+    void json(const std::vector<cv::Rect>& rects) {
+        mBuffer += '[';
+        for (size_t i = 0; i < rects.size(); ++i) {
+            char buf[64];
+            snprintf(buf, sizeof(buf), "%s[%d,%d,%d,%d]", i ? "," : "", rects[i].x, rects[i].y,
+                rects[i].width, rects[i].height);
+            mBuffer += buf;
+        }
+        mBuffer += ']';
+    }
+
+    void number(uint32_t value) {
+        mBuffer.append(reinterpret_cast<const char*>(&value), sizeof(value));
+    }
+
+    void binary(const std::vector<cv::Rect>& rects) {
+        number(uint32_t(rects.size()));
+        for (size_t i = 0; i < rects.size(); ++i) {
+            number(uint32_t(rects[i].x));
+            number(uint32_t(rects[i].y));
+            number(uint32_t(rects[i].width));
+            number(uint32_t(rects[i].height));
+        }
+    }
+
+    int mFd;
+    Format mFormat;
+
+    /**
+     * Set by the first failed write, read by workers without the write mutex.
+     */
+    std::atomic<bool> mFailed;
+
+    /**
+     * Records being added, guarded by mMutex.
+     */
+    std::string mBuffer;
+
+    /**
+     * Records being written, guarded by mWriteMutex. Locked after mMutex if both are.
+     */
+    std::string mWriting;
+    mutable std::mutex mMutex;
+    mutable std::mutex mWriteMutex;
+    size_t mRecords;
+    size_t mBytes;
+};
+
+#endif
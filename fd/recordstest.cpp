@@ -0,0 +1,278 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Stress test of RecordWriter: many threads write records at once in both formats.
+ * Every record must be in the file exactly once and whole, and the counted bytes must match the file.
+ * A failed write must be reported and stop the writer from taking records.
+ */
+
+#include "../common/check.h"
+#include "records.h"
+
+#include <cstdio>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+const int THREADS = 8;
+const int RECORDS = 20000;
+
+string pathOf(int thread, int record) {
+    char buf[64];
+    snprintf(buf, sizeof(buf), "images/%d/%d.jpg", thread, record);
+    return buf;
+}
+
+/**
+ * Records differ in the number of faces and eyes, so they differ in length.
+ */
+void rectsOf(int thread, int record, vector<Rect>& faces, vector<Rect>& eyes) {
+    faces.clear();
+    eyes.clear();
+    for (int i = 0; i < record % 4; ++i) {
+        faces.push_back(Rect(thread, record, 30 + i, 30 + i));
+    }
+    for (int i = 0; i < record % 3; ++i) {
+        eyes.push_back(Rect(record, thread, 10 + i, 10 + i));
+    }
+}
+
+string json(const vector<Rect>& rects) {
+    ostringstream out;
+    out << '[';
+    for (size_t i = 0; i < rects.size(); ++i) {
+        out << (i ? "," : "") << '[' << rects[i].x << ',' << rects[i].y << ',' << rects[i].width << ',' <<
+            rects[i].height << ']';
+    }
+    out << ']';
+
+    return out.str();
+}
+
+string jsonLine(const string& path, const vector<Rect>& faces, const vector<Rect>& eyes) {
+    return "{\"path\":\"" + path + "\",\"faces\":" + json(faces) + ",\"eyes\":" + json(eyes) + "}";
+}
+
+string readFile(const string& path) {
+    ifstream in(path.c_str(), ios::binary);
+    ostringstream out;
+    out << in.rdbuf();
+
+    return out.str();
+}
+
+/**
+ * Reads a 4 byte number of the binary format.
+ * @return false If the data ends.
+ */
+bool number(const string& data, size_t& pos, uint32_t& value) {
+    if (data.size() - pos < sizeof(value)) {
+        return false;
+    }
+    memcpy(&value, data.data() + pos, sizeof(value));
+    pos += sizeof(value);
+
+    return true;
+}
+
+bool rects(const string& data, size_t& pos, vector<Rect>& result) {
+    uint32_t count;
+    if (!number(data, pos, count) || count > 16) {
+        return false;
+    }
+    result.clear();
+    for (uint32_t i = 0; i < count; ++i) {
+        uint32_t v[4];
+        for (int j = 0; j < 4; ++j) {
+            if (!number(data, pos, v[j])) {
+                return false;
+            }
+        }
+        result.push_back(Rect(v[0], v[1], v[2], v[3]));
+    }
+
+    return true;
+}
+
+bool sameRects(const vector<Rect>& a, const vector<Rect>& b) {
+    if (a.size() != b.size()) {
+        return false;
+    }
+    for (size_t i = 0; i < a.size(); ++i) {
+        if (a[i] != b[i]) {
+            return false;
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @return Index of the record with the path, -1 if no record has it.
+ */
+int indexOf(const string& path) {
+    int thread;
+    int record;
+    if (sscanf(path.c_str(), "images/%d/%d.jpg", &thread, &record) != 2 || thread < 0 || thread >= THREADS ||
+        record < 0 || record >= RECORDS || path != pathOf(thread, record)) {
+        return -1;
+    }
+
+    return thread * RECORDS + record;
+}
+
+void stress(const string& dir, RecordWriter::Format format) {
+    string path = dir + (format == RecordWriter::JSON ? "/records.jsonl" : "/records.bin");
+    RecordWriter writer;
+    if (!CHECK(writer.open(path, format))) {
+        return;
+    }
+
+    vector<thread> threads;
+    vector<int> failed(THREADS, 0);
+    for (int t = 0; t < THREADS; ++t) {
+        threads.push_back(thread([&writer, &failed, t]() {
+            vector<Rect> faces;
+            vector<Rect> eyes;
+            for (int r = 0; r < RECORDS; ++r) {
+                rectsOf(t, r, faces, eyes);
+                failed[t] += !writer.write(pathOf(t, r), faces, eyes);
+            }
+        }));
+    }
+    for (int t = 0; t < THREADS; ++t) {
+        threads[t].join();
+        CHECK(failed[t] == 0);
+    }
+    CHECK(writer.close());
+
+    string data = readFile(path);
+    ostringstream report;
+    writer.report(report);
+    ostringstream expected;
+    expected << "records: " << THREADS * RECORDS << " records, " << data.size() << " bytes\n";
+    CHECK(report.str() == expected.str());
+
+    vector<int> seen(THREADS * RECORDS, 0);
+    size_t broken = 0;
+    vector<Rect> faces;
+    vector<Rect> eyes;
+    if (format == RecordWriter::JSON) {
+        istringstream in(data);
+        string line;
+        while (getline(in, line)) {
+            size_t end = line.find('"', 9);
+            int index = line.compare(0, 9, "{\"path\":\"") == 0 && end != string::npos ?
+                indexOf(line.substr(9, end - 9)) : -1;
+            if (index < 0) {
+                ++broken;
+                continue;
+            }
+            rectsOf(index / RECORDS, index % RECORDS, faces, eyes);
+            broken += line != jsonLine(pathOf(index / RECORDS, index % RECORDS), faces, eyes);
+            ++seen[index];
+        }
+        CHECK(!data.empty() && data[data.size() - 1] == '\n');
+    } else {
+        size_t pos = 0;
+        while (pos < data.size()) {
+            uint32_t length;
+            vector<Rect> foundFaces;
+            vector<Rect> foundEyes;
+            if (!number(data, pos, length) || data.size() - pos < length) {
+                ++broken;
+                break;
+            }
+            int index = indexOf(data.substr(pos, length));
+            pos += length;
+            if (index < 0 || !rects(data, pos, foundFaces) || !rects(data, pos, foundEyes)) {
+                ++broken;
+                break;
+            }
+            rectsOf(index / RECORDS, index % RECORDS, faces, eyes);
+            broken += !sameRects(faces, foundFaces) || !sameRects(eyes, foundEyes);
+            ++seen[index];
+        }
+    }
+
+    size_t missing = 0;
+    size_t duplicated = 0;
+    for (size_t i = 0; i < seen.size(); ++i) {
+        missing += seen[i] == 0;
+        duplicated += seen[i] > 1;
+    }
+    cout << (format == RecordWriter::JSON ? "json" : "binary") << ": " << THREADS << " threads, " <<
+        data.size() << " bytes, " << missing << " missing, " << duplicated << " duplicated, " <<
+        broken << " broken" << endl;
+    CHECK(missing == 0);
+    CHECK(duplicated == 0);
+    CHECK(broken == 0);
+}
+
+void testEscaping(const string& dir) {
+    string path = dir + "/escaped.jsonl";
+    RecordWriter writer;
+    if (!CHECK(writer.open(path, RecordWriter::JSON))) {
+        return;
+    }
+    vector<Rect> faces(1, Rect(1, 2, 3, 4));
+    CHECK(writer.write("a\"b\\c\nd\x01.jpg", faces, vector<Rect>()));
+    CHECK(writer.close());
+    CHECK(readFile(path) == "{\"path\":\"a\\\"b\\\\c\\u000ad\\u0001.jpg\",\"faces\":[[1,2,3,4]],\"eyes\":[]}\n");
+}
+
+/**
+ * Once a write fails no more records are taken and close() reports the failure.
+ */
+void testFailure() {
+    RecordWriter writer;
+    if (!CHECK(writer.open("/dev/full", RecordWriter::BINARY))) {
+        return;
+    }
+    vector<Rect> faces(1, Rect(1, 2, 3, 4));
+    int written = 0;
+    while (written < RECORDS && writer.write(pathOf(0, written), faces, faces)) {
+        ++written;
+    }
+    CHECK(written < RECORDS);
+    for (int r = 0; r < 10; ++r) {
+        CHECK(!writer.write(pathOf(1, r), faces, faces));
+    }
+    CHECK(!writer.close());
+
+    ostringstream report;
+    writer.report(report);
+    CHECK(report.str().find(" records, 0 bytes\n") != string::npos);
+
+    // A failure is not carried over to the next file.
+    CHECK(writer.open("/dev/null", RecordWriter::BINARY));
+    CHECK(writer.write(pathOf(0, 0), faces, faces));
+    CHECK(writer.close());
+}
+
+int main(int argc, const char** argv) {
+    if (argc < 2) {
+        cerr << "Usage: " << argv[0] << " directory-for-temporary-files" << endl;
+        return 1;
+    }
+    string dir = argv[1];
+
+    stress(dir, RecordWriter::JSON);
+    stress(dir, RecordWriter::BINARY);
+    testEscaping(dir);
+    testFailure();
+
+    RecordWriter writer;
+    CHECK(!writer.open(dir + "/missing/records.jsonl", RecordWriter::JSON));
+    CHECK(writer.close());
+
+    return check::report("recordstest");
+}
@@ -0,0 +1,226 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Follows faces between keyframes of a video.
+ */
+
+#ifndef SULPRE_FD_TRACKER_H
+#define SULPRE_FD_TRACKER_H
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+/**
+ * Moves faces found on a keyframe through the following frames by searching their templates
+ * in a small neighborhood around the predicted position, and decides when the next keyframe is needed.
+ * The interval between keyframes doubles while faces are followed confidently and barely move,
+ * and halves when matches get weak or faces move fast. A lost face asks for a keyframe right away.
+ */
+class Tracker {
+public:
+
+    /**
+     * @param Minimum number of frames between keyframes
+     * @param Maximum number of frames between keyframes
+     */
+    Tracker(int minInterval = 2, int maxInterval = 32)
+        : mMinInterval(std::max(1, minInterval)), mMaxInterval(std::max(minInterval, maxInterval)),
+        mInterval(mMinInterval), mSinceKey(0), mLost(true), mWorst(1), mMotion(0) {}
+
+    /**
+     * @return true If the next frame should be detected from scratch, always for the first frame.
+     */
+    bool keyframe() const {
+        return mLost || mSinceKey >= mInterval;
+    }
+
+    int interval() const {
+        return mInterval;
+    }
+
+    /**
+     * Starts following faces detected on a keyframe and adapts the interval to how tracking went since the last one.
+     * The interval grows only if there was something to follow, an empty scene is no evidence of stable tracking.
+     * @param Grayscale keyframe
+     * @param Faces
+     * @param Eyes, each one moves with the face it is in
+     */
+    void reset(const cv::Mat& gray, const std::vector<cv::Rect>& faces, const std::vector<cv::Rect>& eyes) {
+        if (mSinceKey > 0) {
+            if (mLost || mWorst < WEAK || mMotion > FAST) {
+                mInterval = std::max(mMinInterval, mInterval / 2);
+            } else if (!mTargets.empty() && mWorst > CONFIDENT && mMotion < SLOW) {
+                mInterval = std::min(mMaxInterval, mInterval * 2);
+            }
+        }
+        mSinceKey = 0;
+        mLost = false;
+        mWorst = 1;
+        mMotion = 0;
+
+        // Faces partly outside the frame are followed by their visible part.
+        cv::Rect frame(0, 0, gray.cols, gray.rows);
+        mTargets.resize(faces.size());
+        size_t count = 0;
+        for (size_t i = 0; i < faces.size(); ++i) {
+            cv::Rect face = faces[i] & frame;
+            if (face.width <= 0 || face.height <= 0) {
+                continue;
+            }
+            Target& t = mTargets[count++];
+            t.rect = face;
+            t.velocity = cv::Point(0, 0);
+            t.scale = std::max(1., double(face.width) / PATCH_SIZE);
+            cv::resize(gray(face), t.patch, cv::Size(), 1 / t.scale, 1 / t.scale, cv::INTER_AREA);
+            t.eyes.clear();
+            for (size_t j = 0; j < eyes.size(); ++j) {
+                cv::Point center(eyes[j].x + eyes[j].width / 2, eyes[j].y + eyes[j].height / 2);
+                if (face.contains(center)) {
+                    t.eyes.push_back(eyes[j] - face.tl());
+                }
+            }
+        }
+        mTargets.resize(count);
+    }
+
+    /**
+     * Moves faces to the frame.
+     * @param Grayscale frame
+     * @param Faces in the frame
+     * @param Eyes in the frame
+     * @return The weakest match, 1 if nothing is followed.
+     */
+    double track(const cv::Mat& gray, std::vector<cv::Rect>& faces, std::vector<cv::Rect>& eyes) {
+        ++mSinceKey;
+        faces.clear();
+        eyes.clear();
+        double worst = 1;
+        cv::Rect frame(0, 0, gray.cols, gray.rows);
+        for (size_t i = 0; i < mTargets.size(); ++i) {
+            Target& t = mTargets[i];
+
+            // Around the position predicted by the last move.
+            cv::Point predicted = t.rect.tl() + t.velocity;
+            // By value, std::max takes references and MIN_MARGIN has no definition to bind them to.
+            int margin = std::max(int(MIN_MARGIN), t.rect.width / 4) + std::abs(t.velocity.x) + std::abs(t.velocity.y);
+            cv::Rect area = cv::Rect(predicted.x - margin, predicted.y - margin,
+                t.rect.width + 2 * margin, t.rect.height + 2 * margin) & frame;
+
+            cv::resize(gray(area), mArea, cv::Size(cvRound(area.width / t.scale), cvRound(area.height / t.scale)),
+                0, 0, cv::INTER_AREA);
+            if (mArea.cols < t.patch.cols || mArea.rows < t.patch.rows) {
+                mLost = true;
+                worst = 0;
+                continue;
+            }
+            cv::matchTemplate(mArea, t.patch, mScores, CV_TM_CCOEFF_NORMED);
+            double score;
+            cv::Point best;
+            cv::minMaxLoc(mScores, 0, &score, 0, &best);
+            worst = std::min(worst, score);
+            if (score < LOST) {
+                mLost = true;
+                continue;
+            }
+
+            // Rounding of the scale may push the face a pixel or two out of the frame.
+            cv::Point moved(area.x + cvRound(best.x * t.scale), area.y + cvRound(best.y * t.scale));
+            moved.x = std::max(0, std::min(moved.x, frame.width - t.rect.width));
+            moved.y = std::max(0, std::min(moved.y, frame.height - t.rect.height));
+            t.velocity = cv::Point(moved.x - t.rect.x, moved.y - t.rect.y);
+            mMotion = std::max(mMotion, double(std::abs(t.velocity.x) + std::abs(t.velocity.y)) / t.rect.width);
+            t.rect.x = moved.x;
+            t.rect.y = moved.y;
+            faces.push_back(t.rect);
+            for (size_t j = 0; j < t.eyes.size(); ++j) {
+                eyes.push_back(t.eyes[j] + t.rect.tl());
+            }
+        }
+        mWorst = std::min(mWorst, worst);
+
+        return worst;
+    }
+
+private:
+
+    /**
+     * Templates are this wide, bigger faces are matched on downscaled frames.
+     */
+    static const int PATCH_SIZE = 32;
+
+    /**
+     * Pixels searched around the predicted position at least.
+     */
+    static const int MIN_MARGIN = 8;
+
+    /**
+     * Match scores: below LOST a face is lost, below WEAK keyframes come more often,
+     * above CONFIDENT they may come less often.
+     */
+    static constexpr double LOST = 0.5;
+    static constexpr double WEAK = 0.7;
+    static constexpr double CONFIDENT = 0.85;
+
+    /**
+     * Moves per frame relative to the face width.
+     */
+    static constexpr double SLOW = 0.02;
+    static constexpr double FAST = 0.1;
+
+    struct Target {
+        cv::Rect rect;
+        cv::Mat patch;
+
+        /**
+         * Template is that many times smaller than the face.
+         */
+        double scale;
+
+        /**
+         * Last move in pixels per frame.
+         */
+        cv::Point velocity;
+
+        /**
+         * Eyes relative to the face.
+         */
+        std::vector<cv::Rect> eyes;
+    };
+
+    int mMinInterval;
+    int mMaxInterval;
+    int mInterval;
+
+    /**
+     * Frames since the last keyframe.
+     */
+    int mSinceKey;
+
+    /**
+     * True if a face was lost since the last keyframe or there was no keyframe yet.
+     */
+    bool mLost;
+
+    /**
+     * The weakest match and the fastest move since the last keyframe.
+     */
+    double mWorst;
+    double mMotion;
+
+    std::vector<Target> mTargets;
+
+    /**
+     * Buffers reused between frames.
+     */
+    cv::Mat mArea;
+    cv::Mat mScores;
+};
+
+#endif
@@ -0,0 +1,120 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Iterative directory walker.
+ */
+
+#ifndef SULPRE_FD_WALKER_H
+#define SULPRE_FD_WALKER_H
+
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+/**
+ * Walks a directory tree depth first in the same order as recursive readdir() would, but without recursion.
+ * Entry types come from dirent::d_type, fstatat() is called only when the file system does not fill it
+ * or the entry is a symlink. Subdirectories are opened relative to their parent and the path of each
+ * entry is built in one reused buffer.
+ */
+class Walker {
+public:
+
+    /**
+     * Walks the tree and calls \a visit(path, name) for every entry that is not a directory,
+     * as soon as it is found.
+     * @param Root directory
+     * @param Callback
+     * @return false If could not open the root.
+     */
+    template<typename Visit>
+    bool walk(const std::string& root, Visit visit) {
+        int fd = open(root.c_str(), O_RDONLY | O_DIRECTORY);
+        DIR* dp = fd >= 0 ? fdopendir(fd) : 0;
+        if (dp == 0) {
+            if (fd >= 0) {
+                close(fd);
+            }
+            return false;
+        }
+
+        mPath = root;
+        std::vector<Frame> stack;
+        Frame top = {dp, mPath.size()};
+        stack.push_back(top);
+
+        while (!stack.empty()) {
+            Frame& frame = stack.back();
+            struct dirent* entry = readdir(frame.dir);
+            if (entry == 0) {
+                closedir(frame.dir);
+                stack.pop_back();
+                continue;
+            }
+
+            const char* name = entry->d_name;
+            if (name[0] == '.' && (name[1] == 0 || (name[1] == '.' && name[2] == 0))) {
+                continue;
+            }
+
+            mPath.resize(frame.length);
+            mPath += '/';
+            mPath += name;
+
+            if (isDir(frame.dir, entry)) {
+                int sub = openat(dirfd(frame.dir), name, O_RDONLY | O_DIRECTORY);
+                DIR* subdp = sub >= 0 ? fdopendir(sub) : 0;
+                if (subdp == 0) {
+                    if (sub >= 0) {
+                        close(sub);
+                    }
+                    continue;
+                }
+                Frame next = {subdp, mPath.size()};
+                stack.push_back(next);
+            } else {
+                visit(mPath, name);
+            }
+        }
+
+        return true;
+    }
+
+private:
+
+    /**
+     * Opened directory and length of its path in the buffer.
+     */
+    struct Frame {
+        DIR* dir;
+        size_t length;
+    };
+
+    /**
+     * Checks if the entry is a directory, symlinks are followed.
+     */
+    static bool isDir(DIR* dir, const struct dirent* entry) {
+        if (entry->d_type == DT_DIR) {
+            return true;
+        }
+        if (entry->d_type != DT_UNKNOWN && entry->d_type != DT_LNK) {
+            return false;
+        }
+
+        struct stat st;
+        return fstatat(dirfd(dir), entry->d_name, &st, 0) == 0 && S_ISDIR(st.st_mode);
+    }
+
+    /**
+     * Path of the current entry.
+     */
+    std::string mPath;
+};
+
+#endif
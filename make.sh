@@ -1,3 +1,15 @@
-g++ fd/fd.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/fd
-g++ shapes/shapes.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv`-o shapes/shapes
-g++ -std=c++11 tpl/tpl.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o tpl/tpl
\ No newline at end of file
+# Stops at the first failing step, so fd is never built against a stale or missing fd/cascades.h.
+set -e
+
+g++ -std=c++11 fd/cascadegen.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/cascadegen
+fd/cascadegen fd/cascades.h FrontalfaceAlt=fd/haarcascade_frontalface_alt.xml EyeTreeEyeglasses=fd/haarcascade_eye_tree_eyeglasses.xml
+g++ -std=c++11 -pthread fd/fd.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/fd
+g++ -std=c++11 shapes/shapes.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o shapes/shapes
+g++ -std=c++11 -pthread tpl/tpl.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o tpl/tpl
+g++ -std=c++11 common/imgbench.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o common/imgbench
+g++ -std=c++11 common/rawconv.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o common/rawconv
+g++ -std=c++11 fd/cascadec.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/cascadec
+g++ -std=c++11 fd/haarbench.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/haarbench
+g++ -std=c++11 -pthread fd/eyebench.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/eyebench
+fd/cascadec fd/haarcascade_frontalface_alt.xml fd/haarcascade_frontalface_alt.bin
+fd/cascadec fd/haarcascade_eye_tree_eyeglasses.xml fd/haarcascade_eye_tree_eyeglasses.bin
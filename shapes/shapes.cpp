@@ -7,6 +7,8 @@
 #include "opencv2/imgproc/imgproc.hpp"
 #include "opencv2/highgui/highgui.hpp"
 
+#include "../common/imgio.h"
+
 #include <iostream>
 #include <math.h>
 #include <string>
@@ -35,12 +37,19 @@ double angle(Point pt1, Point pt2, Point pt0) {
 
 /**
  * Returns sequence of squares detected in the image.
+ * @param Image
+ * @param Result shapes
+ * @param Optional image down-scaled by pyrDown() to reuse.
  */
-void find(const Mat& image, TPoints& shapes) {
+void find(const Mat& image, TPoints& shapes, const Mat* down = 0) {
     Mat pyr, timg, gray0(image.size(), CV_8U), gray;
 
     // Down-scale and upscale the image to filter out the noise.
-    pyrDown(image, pyr, Size(image.cols/2, image.rows/2));
+    if (down && down->cols == image.cols/2 && down->rows == image.rows/2) {
+        pyr = *down;
+    } else {
+        pyrDown(image, pyr, Size(image.cols/2, image.rows/2));
+    }
     pyrUp(pyr, timg, image.size());
     TPoints contours;
     const int thresh = 50, N = 11;
@@ -147,14 +156,14 @@ int main(int argc, const char** argv) {
 
     TPoints shapes;
 
-    Mat image = imread(path, CV_LOAD_IMAGE_COLOR);
-    if (image.empty()) {
+    imgio::Image input;
+    if (!imgio::open(path, input, CV_LOAD_IMAGE_COLOR)) {
         cerr << "Couldn't load image " << path << endl;
         return 1;
     }
 
-    find(image, shapes);
-    draw(image, shapes);
+    find(input.pixels, shapes, input.levels.empty() ? 0 : &input.levels[0]);
+    draw(input.pixels, shapes);
 
     return 0;
 }
@@ -0,0 +1,21 @@
+# Builds and runs the tests, stops at the first failing one.
+# Run make.sh first, haartest checks the generated evaluators of fd/cascades.h too.
+set -e
+
+g++ -std=c++11 common/imgiotest.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o common/imgiotest
+g++ -std=c++11 -pthread fd/queuetest.cpp -o fd/queuetest
+g++ -std=c++11 -pthread fd/recordstest.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/recordstest
+g++ -std=c++11 fd/cachetest.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/cachetest
+g++ -std=c++11 fd/haartest.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o fd/haartest
+g++ -std=c++11 -pthread tpl/tpltest.cpp `pkg-config --cflags opencv` `pkg-config --libs opencv` -o tpl/tpltest
+
+tmp=`mktemp -d`
+trap 'rm -rf "$tmp"' EXIT
+
+common/imgiotest "$tmp"
+fd/queuetest
+fd/recordstest "$tmp"
+fd/cachetest "$tmp"
+fd/haartest fd/haarcascade_frontalface_alt.xml fd/dir "$tmp"
+fd/haartest fd/haarcascade_eye_tree_eyeglasses.xml fd/dir "$tmp"
+tpl/tpltest
@@ -0,0 +1,391 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Search of a needle image in a haystack image by integral sums and brute force verification.
+ */
+
+#ifndef SULPRE_TPL_MATCH_H
+#define SULPRE_TPL_MATCH_H
+
+#include "opencv2/core/core.hpp"
+#include "opencv2/imgproc/imgproc.hpp"
+
+#include "../common/imgio.h"
+
+#include <algorithm>
+#include <atomic>
+#include <climits>
+#include <cmath>
+#include <cstdlib>
+#include <deque>
+#include <thread>
+#include <vector>
+
+namespace tpl {
+
+/**
+ * Creates an integral image \a sum.
+ * @param Source image
+ * @param Integral image
+ */
+inline void integral(const cv::Mat& src, cv::Mat& sum) {
+    sum.create(src.rows, src.cols, CV_MAKETYPE(CV_32S, src.channels()));
+    for (int y = 0; y < src.rows; ++y) {
+        int s = 0;
+        for (int x = 0; x < src.cols; ++x) {
+            cv::Vec3b c = src.at<cv::Vec3b>(cv::Point(x, y));
+            s += c.val[0] + c.val[1] + c.val[2];
+            int a = y > 0 ? sum.at<int>(cv::Point(x, y - 1)) : 0;
+            sum.at<int>(cv::Point(x, y)) = s + a;
+        }
+    }
+}
+
+/**
+ * Decoded image together with its integral.
+ */
+struct Image {
+    /**
+     * Keeps mapped pixels of raw containers alive.
+     */
+    imgio::Image source;
+
+    cv::Mat pixels;
+    cv::Mat sum;
+};
+
+/**
+ * Loads an image and builds its integral.
+ * @return false If could not load.
+ */
+inline bool load(const std::string& path, Image& image) {
+    if (!imgio::open(path, image.source, CV_LOAD_IMAGE_COLOR)) {
+        return false;
+    }
+    image.pixels = image.source.pixels;
+    tpl::integral(image.pixels, image.sum);
+
+    return true;
+}
+
+/**
+ * Candidate item to compare integral images.
+ */
+struct item {
+    /**
+     * Difference between needle integral summ and piece of the same size on haystack.
+     */
+    int diff;
+
+    /**
+     * Coordinates.
+     */
+    int x;
+    int y;
+
+    /**
+     * Sum of piece from haystack.
+     */
+    int sum;
+};
+
+/**
+ * Orientations of the needle: the eight symmetries of a rectangle.
+ */
+enum Variant {
+    IDENTITY = 0,
+    FLIP_HORIZONTAL,
+    FLIP_VERTICAL,
+    ROTATE_180,
+    TRANSPOSE,
+    ROTATE_90,
+    ROTATE_270,
+    ANTI_TRANSPOSE,
+    VARIANTS_COUNT
+};
+
+inline const char* variantName(int variant) {
+    static const char* names[VARIANTS_COUNT] = {
+        "identity", "flip-horizontal", "flip-vertical", "rotate-180",
+        "transpose", "rotate-90", "rotate-270", "anti-transpose"
+    };
+
+    return variant >= 0 && variant < VARIANTS_COUNT ? names[variant] : "unknown";
+}
+
+/**
+ * Result of searching needle in haystack.
+ */
+struct Match {
+    /**
+     * How well needle matches from 0 to 1.
+     */
+    float result;
+
+    /**
+     * Top left corner of found area or -1.
+     */
+    int x;
+    int y;
+
+    /**
+     * Orientation of the needle that matched.
+     */
+    int variant;
+
+    /**
+     * Scale of the needle that matched.
+     */
+    float scale;
+};
+
+/**
+ * Builds all orientations of the needle, indexed by Variant.
+ * Variants from TRANSPOSE on have width and height swapped.
+ */
+inline void variants(const Image& needle, std::vector<Image>& result) {
+    result.resize(VARIANTS_COUNT);
+    result[IDENTITY] = needle;
+    cv::flip(needle.pixels, result[FLIP_HORIZONTAL].pixels, 1);
+    cv::flip(needle.pixels, result[FLIP_VERTICAL].pixels, 0);
+    cv::flip(needle.pixels, result[ROTATE_180].pixels, -1);
+    cv::transpose(needle.pixels, result[TRANSPOSE].pixels);
+    cv::flip(result[TRANSPOSE].pixels, result[ROTATE_90].pixels, 1);
+    cv::flip(result[TRANSPOSE].pixels, result[ROTATE_270].pixels, 0);
+    cv::flip(result[TRANSPOSE].pixels, result[ANTI_TRANSPOSE].pixels, -1);
+    for (int v = IDENTITY + 1; v < VARIANTS_COUNT; ++v) {
+        tpl::integral(result[v].pixels, result[v].sum);
+    }
+}
+
+/**
+ * @return Integral at (x, y), 0 left of or above the image.
+ */
+inline int sumAt(const cv::Mat& sum, int x, int y) {
+    return x < 0 || y < 0 ? 0 : sum.at<int>(y, x);
+}
+
+/**
+ * Collects up to 50 places in haystack whose window sum is closest to the needle sum \a ns.
+ * Places are top left corners of windows, the integral includes the pixel it is at, so the window at (x, y)
+ * is the integral at its bottom right corner minus the ones left of and above it.
+ * @param Haystack integral
+ * @param Window size
+ * @param Needle sum
+ * @param Candidates ordered by diff
+ */
+inline void scan(const cv::Mat& haystack_sum, int cols, int rows, int ns, std::deque<item>& deq) {
+    for (int y = 0; y + rows <= haystack_sum.rows; ++y) {
+        for (int x = 0; x + cols <= haystack_sum.cols; ++x) {
+            int s = sumAt(haystack_sum, x + cols - 1, y + rows - 1) -
+                sumAt(haystack_sum, x - 1, y + rows - 1) -
+                sumAt(haystack_sum, x + cols - 1, y - 1) +
+                sumAt(haystack_sum, x - 1, y - 1);
+
+            int d = std::abs(s - ns);
+            item itm = {d, x, y, s};
+            if (deq.size() > 0) {
+                for (auto it = deq.begin(); it != deq.end(); ++it) {
+                    // Need to store candidates to check further.
+                    if (d < it->diff) {
+                        deq.insert(it, itm);
+                        break;
+                    }
+                }
+            } else {
+                deq.push_front(itm);
+            }
+
+            if (deq.size() > 50) {
+                deq.pop_back();
+            }
+        }
+    }
+}
+
+/**
+ * Compares needle with the piece of haystack at the candidate by brute force.
+ * @return Sum of absolute differences.
+ */
+inline unsigned long long verify(const cv::Mat& haystack, const cv::Mat& needle, const item& itm) {
+    unsigned long long s = 0;
+    for (int j = 0; j < needle.rows; ++j) {
+        for (int i = 0; i < needle.cols; ++i) {
+            cv::Vec3b c1 = haystack.at<cv::Vec3b>(cv::Point(itm.x + i, itm.y + j));
+            cv::Vec3b c2 = needle.at<cv::Vec3b>(cv::Point(i, j));
+            s += std::abs(c1.val[0] - c2.val[0]);
+            s += std::abs(c1.val[1] - c2.val[1]);
+            s += std::abs(c1.val[2] - c2.val[2]);
+        }
+    }
+
+    return s;
+}
+
+/**
+ * Searches needle in haystack.
+ */
+inline Match match(const Image& haystack, const Image& needle) {
+    const cv::Mat& needle_sum = needle.sum;
+    int ns = needle_sum.at<int>(needle_sum.rows - 1, needle_sum.cols - 1);
+
+    // Contains candidate results.
+    std::deque<item> deq;
+    scan(haystack.sum, needle_sum.cols, needle_sum.rows, ns, deq);
+
+    const int nc = 3; // Number of channels.
+    const int byte = 255; // One byte.
+    const int max = needle.pixels.rows * needle.pixels.cols * byte * nc; // Maximum value that can be in comparing by brute force.
+
+    Match m;
+    m.result = !deq.empty() && deq[0].diff == 0 ? 1 : 0;
+    m.variant = IDENTITY;
+    m.scale = 1;
+    int min = INT_MAX;
+    // Result point.
+    m.x = !deq.empty() && deq[0].diff == 0 ? deq[0].x : -1;
+    m.y = !deq.empty() && deq[0].diff == 0 ? deq[0].y : -1;
+
+    // If perfect result has not been found -> need to find it by brute force.
+    if (m.result != 1) {
+        for (size_t d = 0; d < deq.size(); ++d) {
+            unsigned long long s = verify(haystack.pixels, needle.pixels, deq[d]);
+            if (s < min) {
+                min = s;
+                m.x = deq[d].x;
+                m.y = deq[d].y;
+                m.result = 1 - (float(min) / max);
+            }
+            if (s == 0) {
+                break;
+            }
+        }
+    }
+
+    return m;
+}
+
+/**
+ * Searches needle in haystack in any of its orientations.
+ * The window sum does not depend on orientation, so candidates are collected once per window shape
+ * and only the brute force verification is done for every variant.
+ * @param Variants built by variants()
+ */
+inline Match match(const Image& haystack, const std::vector<Image>& needles) {
+    const Image& needle = needles[IDENTITY];
+    int ns = needle.sum.at<int>(needle.sum.rows - 1, needle.sum.cols - 1);
+
+    const int nc = 3; // Number of channels.
+    const int byte = 255; // One byte.
+    const int max = needle.pixels.rows * needle.pixels.cols * byte * nc; // Maximum value that can be in comparing by brute force.
+
+    Match m = {0, -1, -1, IDENTITY, 1};
+    unsigned long long min = ULLONG_MAX;
+
+    // Square needles share one window shape for all variants.
+    bool square = needle.pixels.rows == needle.pixels.cols;
+    for (int shape = 0; shape < (square ? 1 : 2); ++shape) {
+        const cv::Mat& sum = needles[shape ? TRANSPOSE : IDENTITY].sum;
+        std::deque<item> deq;
+        scan(haystack.sum, sum.cols, sum.rows, ns, deq);
+
+        int first = square || shape == 0 ? IDENTITY : TRANSPOSE;
+        int last = square || shape == 1 ? VARIANTS_COUNT : TRANSPOSE;
+        for (size_t d = 0; d < deq.size(); ++d) {
+            for (int v = first; v < last; ++v) {
+                unsigned long long s = verify(haystack.pixels, needles[v].pixels, deq[d]);
+                if (s < min) {
+                    min = s;
+                    m.x = deq[d].x;
+                    m.y = deq[d].y;
+                    m.variant = v;
+                    m.result = 1 - (float(min) / max);
+                }
+                if (s == 0) {
+                    return m;
+                }
+            }
+        }
+    }
+
+    return m;
+}
+
+/**
+ * Searches needle resized to each of \a scales in haystack.
+ * The haystack integral is shared by all scales, scales are processed in parallel
+ * starting from the most likely ones (closest to the native size, then the cheapest)
+ * and the search stops as soon as a perfect match is found.
+ * @param Scales to try
+ * @param Search in all orientations too
+ * @param Number of threads
+ */
+inline Match match(const Image& haystack, const Image& needle, const std::vector<float>& scales, bool anyOrientation,
+    unsigned threads) {
+    // Order of scales to try.
+    std::vector<float> order;
+    for (size_t i = 0; i < scales.size(); ++i) {
+        int cols = cvRound(needle.pixels.cols * scales[i]);
+        int rows = cvRound(needle.pixels.rows * scales[i]);
+        if (cols > 0 && rows > 0 && cols <= haystack.pixels.cols && rows <= haystack.pixels.rows) {
+            order.push_back(scales[i]);
+        }
+    }
+    std::sort(order.begin(), order.end(), [](float a, float b) {
+        float la = std::fabs(std::log(a)), lb = std::fabs(std::log(b));
+        return la != lb ? la < lb : a < b;
+    });
+
+    Match none = {0, -1, -1, IDENTITY, 1};
+    std::vector<Match> results(order.size(), none);
+    std::atomic<size_t> next(0);
+    std::atomic<bool> perfect(false);
+
+    auto work = [&]() {
+        for (size_t i = next++; i < order.size() && !perfect; i = next++) {
+            Image scaled;
+            cv::Size size(cvRound(needle.pixels.cols * order[i]), cvRound(needle.pixels.rows * order[i]));
+            cv::resize(needle.pixels, scaled.pixels, size, 0, 0, order[i] < 1 ? cv::INTER_AREA : cv::INTER_LINEAR);
+            tpl::integral(scaled.pixels, scaled.sum);
+
+            if (anyOrientation) {
+                std::vector<Image> needles;
+                variants(scaled, needles);
+                results[i] = match(haystack, needles);
+            } else {
+                results[i] = match(haystack, scaled);
+            }
+            results[i].scale = order[i];
+            if (results[i].result == 1) {
+                perfect = true;
+            }
+        }
+    };
+
+    std::vector<std::thread> pool;
+    for (unsigned t = 1; t < threads && t < order.size(); ++t) {
+        pool.push_back(std::thread(work));
+    }
+    work();
+    for (size_t t = 0; t < pool.size(); ++t) {
+        pool[t].join();
+    }
+
+    // Earlier scales win ties, so the result does not depend on thread timing
+    // unless a perfect match stopped the search.
+    Match m = none;
+    for (size_t i = 0; i < results.size(); ++i) {
+        if (results[i].x >= 0 && (m.x < 0 || results[i].result > m.result)) {
+            m = results[i];
+        }
+    }
+
+    return m;
+}
+
+} // namespace tpl
+
+#endif
@@ -8,167 +8,815 @@
  * The algorithm tries to find areas in haystack-image that resemble needle-image. 
  * In other words searches small image in big image. Very simplified method.
  * And returns result how well needle image can match in haystack.
+ *
+ * Can also run as a daemon on a local UNIX socket to keep decoded images resident between queries.
  */
 
 #include "opencv2/core/core.hpp"
 #include "opencv2/imgproc/imgproc.hpp"
 #include "opencv2/highgui/highgui.hpp"
 
+#include "../common/imgio.h"
+#include "match.h"
+
+#include <cerrno>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
 #include <climits>
+#include <cmath>
+#include <cstdio>
 #include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <deque>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <vector>
+#include <csignal>
+#include <fcntl.h>
+#include <unistd.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
 
 using namespace cv;
 using namespace std;
 
 void showHelp(const char *appName) {
     cerr << "Searches needle image in haystack and returns result match value from 0 to 1.\n" <<
-        "Usage: " << appName << " haystack needle\n" <<
+        "Usage: " << appName << " [--any-orientation] [--scales MIN:MAX[:STEP]] [--client SOCKET] haystack needle\n" <<
+        "       " << appName << " --daemon SOCKET [WORKERS]\n" <<
+        "Options:\n" <<
+        "  --any-orientation  Also match the needle rotated by 90/180/270 degrees or mirrored.\n" <<
+        "  --scales MIN:MAX[:STEP]\n" <<
+        "                     Also match the needle resized from MIN to MAX times, 0.1 step by default.\n" <<
+        "  --client SOCKET    Send the query to a running daemon.\n" <<
         "Using OpenCV version " << CV_VERSION << "\n";
 }
 
 namespace tpl {
 
 /**
- * Creates an integral image \a sum.
- * @param Source image
- * @param Integral image
+ * Keeps recently used images decoded in memory.
+ * Entries are invalidated when the file on disk changes.
  */
-void integral(const Mat& src, Mat& sum) {
-    sum.create(src.rows, src.cols, CV_MAKETYPE(CV_32S, src.channels()));
-    for (int y = 0; y < src.rows; ++y) {
-        int s = 0;
-        for (int x = 0; x < src.cols; ++x) {
-            Vec3b c = src.at<Vec3b>(Point(x, y));
-            s += c.val[0] + c.val[1] + c.val[2];
-            int a = y > 0 ? sum.at<int>(Point(x, y - 1)) : 0;
-            sum.at<int>(Point(x, y)) = s + a;
+class Cache {
+public:
+
+    /**
+     * @param Maximum number of images to keep.
+     */
+    Cache(size_t capacity) : mCapacity(capacity) {}
+
+    /**
+     * Returns decoded image by path, loads it if needed.
+     * @return 0 If could not load.
+     */
+    shared_ptr<const Image> get(const string& path) {
+        struct stat st;
+        if (stat(path.c_str(), &st) != 0) {
+            return shared_ptr<const Image>();
         }
+
+        {
+            lock_guard<mutex> lock(mMutex);
+            auto it = mEntries.find(path);
+            if (it != mEntries.end()) {
+                if (it->second.mtime == st.st_mtime && it->second.size == st.st_size) {
+                    mLru.splice(mLru.begin(), mLru, it->second.lru);
+                    return it->second.image;
+                }
+                mLru.erase(it->second.lru);
+                mEntries.erase(it);
+            }
+        }
+
+        // Decode outside of the lock, other workers may use the cache meanwhile.
+        shared_ptr<Image> image = make_shared<Image>();
+        if (!load(path, *image)) {
+            return shared_ptr<const Image>();
+        }
+
+        lock_guard<mutex> lock(mMutex);
+        if (mEntries.find(path) == mEntries.end()) {
+            mLru.push_front(path);
+            Entry e = {image, shared_ptr<const vector<Image> >(), st.st_mtime, st.st_size, mLru.begin()};
+            mEntries[path] = e;
+            if (mEntries.size() > mCapacity) {
+                mEntries.erase(mLru.back());
+                mLru.pop_back();
+            }
+        }
+
+        return image;
     }
-}
 
-} // namespace tpl
+    /**
+     * Returns the image by path in all orientations.
+     * They are built once per decoded image and dropped with it when the file on disk changes.
+     * @return 0 If could not load.
+     */
+    shared_ptr<const vector<Image> > variants(const string& path) {
+        shared_ptr<const Image> image = get(path);
+        if (!image) {
+            return shared_ptr<const vector<Image> >();
+        }
+
+        {
+            lock_guard<mutex> lock(mMutex);
+            auto it = mEntries.find(path);
+            if (it != mEntries.end() && it->second.image == image && it->second.variants) {
+                return it->second.variants;
+            }
+        }
+
+        shared_ptr<vector<Image> > result = make_shared<vector<Image> >();
+        tpl::variants(*image, *result);
+
+        lock_guard<mutex> lock(mMutex);
+        auto it = mEntries.find(path);
+        if (it != mEntries.end() && it->second.image == image) {
+            it->second.variants = result;
+        }
+
+        return result;
+    }
+
+private:
+
+    struct Entry {
+        shared_ptr<const Image> image;
+
+        /**
+         * Orientations of the image, built on first request.
+         */
+        shared_ptr<const vector<Image> > variants;
+        time_t mtime;
+        off_t size;
+        list<string>::iterator lru;
+    };
+
+    size_t mCapacity;
+    mutex mMutex;
+    map<string, Entry> mEntries;
+
+    /**
+     * Paths ordered from most to least recently used.
+     */
+    list<string> mLru;
+};
 
 /**
- * Candidate item to compare integral images.
+ * Wire protocol of the daemon. All integers are in host byte order.
+ *
+ * Request:  uint32 flags, uint32 haystack path length, uint32 needle path length, haystack path, needle path.
+ * Response: int32 status, float result, int32 x, int32 y, int32 variant.
+ *
+ * A client may send any number of requests on one connection without waiting,
+ * responses come back in the same order.
+ * Status is LOAD_FAILED if an image could not be loaded, MATCH_FAILED if matching loaded images failed.
  */
-struct item {
+namespace protocol {
+
+enum Status {
+    OK = 0,
+    LOAD_FAILED = 1,
+    MATCH_FAILED = 2
+};
+
+enum Flags {
     /**
-     * Difference between needle integral summ and piece of the same size on haystack.
+     * Search the needle in all eight orientations.
      */
-    int diff;
+    ANY_ORIENTATION = 1
+};
+
+struct Request {
+    uint32_t flags;
+    uint32_t haystackLength;
+    uint32_t needleLength;
+};
+
+struct Response {
+    int32_t status;
+    float result;
+    int32_t x;
+    int32_t y;
+    int32_t variant;
+};
+
+/**
+ * Maximum accepted length of a path.
+ */
+const uint32_t MAX_PATH_LENGTH = 4096;
+
+/**
+ * Reads exactly \a size bytes.
+ * @return false If connection closed or failed.
+ */
+bool readAll(int fd, void* buf, size_t size) {
+    char* p = static_cast<char*>(buf);
+    while (size > 0) {
+        ssize_t n = ::read(fd, p, size);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
+
+/**
+ * Writes exactly \a size bytes.
+ */
+bool writeAll(int fd, const void* buf, size_t size) {
+    const char* p = static_cast<const char*>(buf);
+    while (size > 0) {
+        ssize_t n = ::write(fd, p, size);
+        if (n <= 0) {
+            if (n < 0 && errno == EINTR) {
+                continue;
+            }
+            return false;
+        }
+        p += n;
+        size -= n;
+    }
+
+    return true;
+}
 
+enum Parsed {
     /**
-     * Coordinates.
+     * More bytes are needed.
      */
-    int x;
-    int y;
+    INCOMPLETE,
+    COMPLETE,
 
     /**
-     * Sum of piece from haystack.
+     * The bytes can't be a request, the connection should be closed.
      */
-    int sum;
+    MALFORMED
 };
 
+/**
+ * Takes one request from the start of bytes read from a connection so far.
+ * The bytes of the taken request are erased from \a buffer, bytes of further requests are kept.
+ */
+Parsed takeRequest(string& buffer, uint32_t& flags, string& haystack, string& needle) {
+    Request req;
+    if (buffer.size() < sizeof(req)) {
+        return INCOMPLETE;
+    }
+    memcpy(&req, buffer.data(), sizeof(req));
+    if (req.haystackLength > MAX_PATH_LENGTH || req.needleLength > MAX_PATH_LENGTH) {
+        return MALFORMED;
+    }
+    size_t size = sizeof(req) + req.haystackLength + req.needleLength;
+    if (buffer.size() < size) {
+        return INCOMPLETE;
+    }
 
-int main(int argc, const char** argv) {
-    string haystack_path, needle_path;
-    if (argc > 2) {
-        haystack_path = argv[1];
-        needle_path = argv[2];
+    flags = req.flags;
+    haystack.assign(buffer, sizeof(req), req.haystackLength);
+    needle.assign(buffer, sizeof(req) + req.haystackLength, req.needleLength);
+    buffer.erase(0, size);
+
+    return COMPLETE;
+}
+
+/**
+ * Writes one request.
+ */
+bool writeRequest(int fd, uint32_t flags, const string& haystack, const string& needle) {
+    Request req = {flags, uint32_t(haystack.size()), uint32_t(needle.size())};
+
+    return writeAll(fd, &req, sizeof(req)) &&
+        writeAll(fd, haystack.data(), haystack.size()) &&
+        writeAll(fd, needle.data(), needle.size());
+}
+
+} // namespace protocol
+
+/**
+ * Set by SIGINT and SIGTERM: the daemon stops accepting, answers the requests it has and exits.
+ */
+volatile sig_atomic_t stopRequested = 0;
+
+/**
+ * Write end of the wake pipe of the running daemon, so a signal handled by any thread wakes its poll up.
+ */
+int stopWake = -1;
+
+void requestStop(int) {
+    int saved = errno;
+    stopRequested = 1;
+    char c = 0;
+    if (stopWake >= 0 && write(stopWake, &c, 1) < 0) {
+        // The pipe is full, the poll wakes up anyway.
     }
-    if (haystack_path.empty()) {
-        showHelp(argv[0]);
-        return 1;
+    errno = saved;
+}
+
+/**
+ * Serves matching requests over a UNIX-domain socket using a pool of workers.
+ * Connections are dispatched per request: the accepting thread polls idle connections, reads what they send
+ * and hands a connection with a complete request to a worker, which answers it and gives the connection back.
+ * A busy or slow client can't hold a worker while other clients wait, and its pipelined requests are served
+ * in order because only one worker has it at a time.
+ */
+class Daemon {
+public:
+
+    /**
+     * Maximum number of workers.
+     */
+    static const long MAX_WORKERS = 1024;
+
+    /**
+     * Longest wait for accepting again after accept() failed, e.g. because no descriptors are left.
+     */
+    static const int MAX_ACCEPT_BACKOFF_MS = 1000;
+
+    /**
+     * A worker drops a connection that doesn't read its responses for this long.
+     */
+    static const int SEND_TIMEOUT_SECONDS = 5;
+
+    /**
+     * @param Socket path
+     * @param Number of workers
+     * @param Number of images to keep decoded
+     */
+    Daemon(const string& path, unsigned workers, size_t cacheSize)
+        : mPath(path), mWorkers(workers), mCache(cacheSize), mSocket(-1) {
+        mWake[0] = mWake[1] = -1;
     }
 
-    Mat haystack = imread(haystack_path, CV_LOAD_IMAGE_COLOR);
-    Mat needle = imread(needle_path, CV_LOAD_IMAGE_COLOR);
-    if (haystack.empty() || needle.empty()) {
-        cerr << "Couldn't load images!" << endl;
-        return 1;
+    ~Daemon() {
+        stopWake = -1;
+        if (mSocket >= 0) {
+            close(mSocket);
+            unlink(mPath.c_str());
+        }
+        for (int i = 0; i < 2; ++i) {
+            if (mWake[i] >= 0) {
+                close(mWake[i]);
+            }
+        }
     }
 
-    Mat haystack_sum;
-    tpl::integral(haystack, haystack_sum);
+    /**
+     * Accepts connections and dispatches their requests until SIGINT or SIGTERM.
+     * Failing accept() is retried later, the daemon keeps serving connections it has meanwhile.
+     * @return false If could not listen on the socket or polling failed.
+     */
+    bool run() {
+        struct sockaddr_un addr;
+        if (mPath.size() >= sizeof(addr.sun_path)) {
+            cerr << "Socket path is too long: " << mPath << endl;
+            return false;
+        }
+        memset(&addr, 0, sizeof(addr));
+        addr.sun_family = AF_UNIX;
+        strncpy(addr.sun_path, mPath.c_str(), sizeof(addr.sun_path) - 1);
+
+        mSocket = socket(AF_UNIX, SOCK_STREAM, 0);
+        if (mSocket < 0 || pipe(mWake) != 0) {
+            return false;
+        }
+        unlink(mPath.c_str());
+        if (bind(mSocket, (struct sockaddr*)&addr, sizeof(addr)) != 0 || listen(mSocket, SOMAXCONN) != 0) {
+            cerr << "Could not listen on " << mPath << endl;
+            return false;
+        }
+        // A connection can be gone between poll() and accept(), which must not block then.
+        fcntl(mSocket, F_SETFL, fcntl(mSocket, F_GETFL) | O_NONBLOCK);
 
-    Mat needle_sum;
-    tpl::integral(needle, needle_sum);
+        // A client that disconnects early must not kill the daemon.
+        signal(SIGPIPE, SIG_IGN);
+        stopRequested = 0;
+        stopWake = mWake[1];
+        signal(SIGINT, requestStop);
+        signal(SIGTERM, requestStop);
 
-    int ns = needle_sum.at<int>(needle_sum.rows - 1, needle_sum.cols - 1);
+        vector<thread> pool;
+        for (unsigned i = 0; i < mWorkers; ++i) {
+            pool.push_back(thread(&Daemon::work, this));
+        }
 
-    // Contains candidate results.
-    deque<item> deq;
+        // Bytes read from each connection that are not a complete request yet. Only this thread reads
+        // and closes connections, workers give them back even if broken, so descriptors are not reused meanwhile.
+        map<int, string> buffers;
+        // Connections waiting for their next request.
+        vector<int> idle;
+        vector<pollfd> fds;
+        int backoff = 0;
+        chrono::steady_clock::time_point acceptAgain;
+        bool failed = false;
+        while (!stopRequested) {
+            int timeout = -1;
+            bool accepting = true;
+            if (backoff > 0) {
+                timeout = int(chrono::duration_cast<chrono::milliseconds>(
+                    acceptAgain - chrono::steady_clock::now()).count());
+                accepting = timeout <= 0;
+                timeout = accepting ? -1 : timeout;
+            }
 
-    for (int y = 0; y < haystack_sum.rows - needle_sum.rows; ++y) {
-        for (int x = 0; x < haystack_sum.cols - needle_sum.cols; ++x) {
-            int s = haystack_sum.at<int>(y, x) +
-                haystack_sum.at<int>(y + needle_sum.rows, x + needle_sum.cols) -
-                haystack_sum.at<int>(y, x + needle_sum.cols) -
-                haystack_sum.at<int>(y + needle_sum.rows, x);
+            fds.clear();
+            pollfd listening = {mSocket, short(accepting ? POLLIN : 0), 0};
+            pollfd wake = {mWake[0], POLLIN, 0};
+            fds.push_back(listening);
+            fds.push_back(wake);
+            for (size_t i = 0; i < idle.size(); ++i) {
+                pollfd client = {idle[i], POLLIN, 0};
+                fds.push_back(client);
+            }
+            if (poll(&fds[0], fds.size(), timeout) < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                cerr << "Could not poll: " << strerror(errno) << endl;
+                failed = true;
+                break;
+            }
 
-            int d = abs(s - ns);
-            item itm = {d, x, y, s};
-            if (deq.size() > 0) {
-                for (auto it = deq.begin(); it != deq.end(); ++it) {
-                    // Need to store candidates to check further.
-                    if (d < it->diff) {
-                        deq.insert(it, itm);
-                        break;
+            size_t kept = 0;
+            for (size_t i = 0; i < idle.size(); ++i) {
+                int client = idle[i];
+                if (!fds[i + 2].revents) {
+                    idle[kept++] = client;
+                    continue;
+                }
+                char buf[4096];
+                ssize_t n = read(client, buf, sizeof(buf));
+                if (n < 0 && (errno == EINTR || errno == EAGAIN)) {
+                    idle[kept++] = client;
+                } else if (n <= 0) {
+                    close(client);
+                    buffers.erase(client);
+                } else {
+                    buffers[client].append(buf, n);
+                    if (!dispatch(client, buffers)) {
+                        idle[kept++] = client;
                     }
                 }
-            } else {
-                deq.push_front(itm);
             }
+            idle.resize(kept);
 
-            if (deq.size() > 50) {
-                deq.pop_back();
+            if (fds[1].revents) {
+                // Bytes left in the pipe wake the next poll up again.
+                char buf[64];
+                if (read(mWake[0], buf, sizeof(buf)) < 0 && errno != EINTR) {
+                    cerr << "Could not read the wake pipe: " << strerror(errno) << endl;
+                    failed = true;
+                    break;
+                }
+                vector<Returned> returned;
+                {
+                    lock_guard<mutex> lock(mMutex);
+                    returned.swap(mReturned);
+                }
+                for (size_t i = 0; i < returned.size(); ++i) {
+                    int client = returned[i].client;
+                    if (!returned[i].open) {
+                        close(client);
+                        buffers.erase(client);
+                    } else if (!dispatch(client, buffers)) {
+                        // Pipelined requests already read are dispatched without waiting for more bytes.
+                        idle.push_back(client);
+                    }
+                }
             }
+
+            if (fds[0].revents) {
+                int client = accept(mSocket, 0, 0);
+                if (client >= 0) {
+                    backoff = 0;
+                    struct timeval sendTimeout = {SEND_TIMEOUT_SECONDS, 0};
+                    setsockopt(client, SOL_SOCKET, SO_SNDTIMEO, &sendTimeout, sizeof(sendTimeout));
+                    idle.push_back(client);
+                } else if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK || errno == EOPNOTSUPP) {
+                    cerr << "Could not accept: " << strerror(errno) << endl;
+                    failed = true;
+                    break;
+                } else if (errno != EINTR && errno != EAGAIN && errno != EWOULDBLOCK && errno != ECONNABORTED) {
+                    // Out of descriptors or memory: serve connections there are until some are closed.
+                    backoff = min(max(backoff * 2, 10), int(MAX_ACCEPT_BACKOFF_MS));
+                    acceptAgain = chrono::steady_clock::now() + chrono::milliseconds(backoff);
+                    cerr << "Could not accept: " << strerror(errno) << ", retrying in " << backoff << " ms" << endl;
+                }
+            }
+        }
+
+        {
+            lock_guard<mutex> lock(mMutex);
+            mPending.push_back(Job());
+            mReady.notify_all();
+        }
+        for (size_t i = 0; i < pool.size(); ++i) {
+            pool[i].join();
+        }
+        for (size_t i = 0; i < mReturned.size(); ++i) {
+            idle.push_back(mReturned[i].client);
+        }
+        for (size_t i = 0; i < idle.size(); ++i) {
+            close(idle[i]);
         }
+
+        return !failed;
     }
 
-    const int nc = 3; // Number of channels.
-    const int byte = 255; // One byte.
-    const int max = needle.rows * needle.cols * byte * nc; // Maximum value that can be in comparing by brute force.
+private:
+
+    /**
+     * Complete request of a connection.
+     */
+    struct Job {
+        Job() : client(-1), flags(0) {}
+
+        /**
+         * -1 for the stop marker.
+         */
+        int client;
+        uint32_t flags;
+        string haystack;
+        string needle;
+    };
+
+    /**
+     * Connection given back by a worker.
+     */
+    struct Returned {
+        int client;
+
+        /**
+         * false If the connection broke and must be closed.
+         */
+        bool open;
+    };
+
+    /**
+     * Hands the first complete request of a connection to a worker, closes a connection that sent garbage.
+     * @return false If no request is complete yet, the connection has to be polled.
+     */
+    bool dispatch(int client, map<int, string>& buffers) {
+        Job job;
+        string& buffer = buffers[client];
+        protocol::Parsed parsed = protocol::takeRequest(buffer, job.flags, job.haystack, job.needle);
+        if (parsed == protocol::INCOMPLETE) {
+            return false;
+        }
+        if (parsed == protocol::MALFORMED) {
+            close(client);
+            buffers.erase(client);
+            return true;
+        }
 
-    float result = !deq.empty() && deq[0].diff == 0 ? 1 : 0;
-    int min = INT_MAX;
-    // Result point.
-    int rx = !deq.empty() && deq[0].diff == 0 ? deq[0].x : -1;
-    int ry = !deq.empty() && deq[0].diff == 0 ? deq[0].y : -1;
+        job.client = client;
+        lock_guard<mutex> lock(mMutex);
+        mPending.push_back(job);
+        mReady.notify_one();
 
-    // If perfect result has not been found -> need to find it by brute force.
-    if (result != 1) {
-        for (int d = 0; d < deq.size(); ++d) {
-            unsigned long long s = 0;
-            for (int j = 0; j < needle.rows; ++j) {
-                for (int i = 0; i < needle.cols; ++i) {
-                    Vec3b c1 = haystack.at<Vec3b>(Point(deq[d].x + i, deq[d].y + j));
-                    Vec3b c2 = needle.at<Vec3b>(Point(i, j));
-                    s += abs(c1.val[0] - c2.val[0]);
-                    s += abs(c1.val[1] - c2.val[1]);
-                    s += abs(c1.val[2] - c2.val[2]);
+        return true;
+    }
+
+    /**
+     * Worker loop: takes a complete request, answers it and gives the connection back.
+     */
+    void work() {
+        for (;;) {
+            Job job;
+            {
+                unique_lock<mutex> lock(mMutex);
+                mReady.wait(lock, [this] { return !mPending.empty(); });
+                if (mPending.front().client < 0) {
+                    // Stop marker, leave it for other workers.
+                    return;
                 }
+                job = std::move(mPending.front());
+                mPending.pop_front();
             }
 
-            if (s < min) {
-                min = s;
-                rx = deq[d].x;
-                ry = deq[d].y;
-                result = 1 - (float(min) / max);
+            Returned returned = {job.client, serve(job)};
+            {
+                lock_guard<mutex> lock(mMutex);
+                mReturned.push_back(returned);
             }
-            if (s == 0) {
-                break;
+            char c = 0;
+            while (write(mWake[1], &c, 1) < 0 && errno == EINTR) {}
+        }
+    }
+
+    /**
+     * Answers one request.
+     * @return false If the connection is broken.
+     */
+    bool serve(const Job& job) {
+        protocol::Response resp = {protocol::OK, 0, -1, -1, IDENTITY};
+        shared_ptr<const Image> haystack = mCache.get(job.haystack);
+        shared_ptr<const Image> needle;
+        shared_ptr<const vector<Image> > needles;
+        if (job.flags & protocol::ANY_ORIENTATION) {
+            needles = mCache.variants(job.needle);
+        } else {
+            needle = mCache.get(job.needle);
+        }
+        if (!haystack || (!needle && !needles)) {
+            resp.status = protocol::LOAD_FAILED;
+        } else {
+            try {
+                Match m = needles ? match(*haystack, *needles) : match(*haystack, *needle);
+                resp.result = m.result;
+                resp.x = m.x;
+                resp.y = m.y;
+                resp.variant = m.variant;
+            } catch (Exception& e) {
+                cerr << e.what() << endl;
+                resp.status = protocol::MATCH_FAILED;
+            }
+        }
+
+        return protocol::writeAll(job.client, &resp, sizeof(resp));
+    }
+
+    string mPath;
+    unsigned mWorkers;
+    Cache mCache;
+    int mSocket;
+
+    /**
+     * Pipe that wakes the polling thread up when a worker gives a connection back or a stop is requested.
+     */
+    int mWake[2];
+
+    /**
+     * Requests waiting for a worker.
+     */
+    deque<Job> mPending;
+
+    /**
+     * Connections answered by workers, not polled yet.
+     */
+    vector<Returned> mReturned;
+    mutex mMutex;
+    condition_variable mReady;
+};
+
+/**
+ * Sends one request to a running daemon.
+ * @return false If could not connect or the daemon could not load images.
+ */
+bool query(const string& path, uint32_t flags, const string& haystack, const string& needle, Match& m) {
+    struct sockaddr_un addr;
+    if (path.size() >= sizeof(addr.sun_path)) {
+        return false;
+    }
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strncpy(addr.sun_path, path.c_str(), sizeof(addr.sun_path) - 1);
+
+    int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) {
+        return false;
+    }
+
+    protocol::Response resp;
+    bool ok = connect(fd, (struct sockaddr*)&addr, sizeof(addr)) == 0 &&
+        protocol::writeRequest(fd, flags, haystack, needle) &&
+        protocol::readAll(fd, &resp, sizeof(resp)) &&
+        resp.status == protocol::OK;
+    close(fd);
+
+    if (ok) {
+        m.result = resp.result;
+        m.x = resp.x;
+        m.y = resp.y;
+        m.variant = resp.variant;
+    }
+
+    return ok;
+}
+
+} // namespace tpl
+
+int main(int argc, const char** argv) {
+    if (argc > 2 && string(argv[1]) == "--daemon") {
+        unsigned workers = thread::hardware_concurrency();
+        if (argc > 3) {
+            char* end = 0;
+            long n = strtol(argv[3], &end, 10);
+            if (*end || n < 1 || n > tpl::Daemon::MAX_WORKERS) {
+                cerr << "WORKERS must be from 1 to " << tpl::Daemon::MAX_WORKERS << endl;
+                return 1;
+            }
+            workers = unsigned(n);
+        }
+        tpl::Daemon daemon(argv[2], workers > 0 ? workers : 1, 64);
+
+        return daemon.run() ? 0 : 1;
+    }
+
+    string haystack_path, needle_path, socket_path;
+    bool anyOrientation = false;
+    vector<float> scales;
+    vector<string> args;
+    for (int i = 1; i < argc; ++i) {
+        string arg = argv[i];
+        if (arg == "--any-orientation") {
+            anyOrientation = true;
+        } else if (arg == "--scales" && i + 1 < argc) {
+            float from = 1, to = 1, step = 0.1f;
+            if (sscanf(argv[++i], "%f:%f:%f", &from, &to, &step) < 2 || from <= 0 || to < from || step <= 0) {
+                showHelp(argv[0]);
+                return 1;
+            }
+            for (float f = from; f <= to + step / 2; f += step) {
+                scales.push_back(f);
             }
+        } else if (arg == "--client" && i + 1 < argc) {
+            socket_path = argv[++i];
+        } else {
+            args.push_back(arg);
         }
     }
+    if (args.size() > 1) {
+        haystack_path = args[0];
+        needle_path = args[1];
+    }
+    if (haystack_path.empty()) {
+        showHelp(argv[0]);
+        return 1;
+    }
 
-    cout << "Result: " << result << endl;
-    if (result) {
-        cout << "Found at [" << rx << "," << ry << "]" << endl;
-        rectangle(haystack, Point(rx, ry), Point(rx + needle.cols, ry + needle.rows), Scalar::all(0), 2, 8, 0);
-        imshow("Result", haystack);
+    if (!socket_path.empty()) {
+        if (!scales.empty()) {
+            cerr << "The daemon does not support --scales." << endl;
+            return 1;
+        }
+        tpl::Match m;
+        uint32_t flags = anyOrientation ? tpl::protocol::ANY_ORIENTATION : 0;
+        if (!tpl::query(socket_path, flags, haystack_path, needle_path, m)) {
+            cerr << "Query failed!" << endl;
+            return 1;
+        }
+        cout << "Result: " << m.result << endl;
+        if (m.result) {
+            cout << "Found at [" << m.x << "," << m.y << "]" << endl;
+            if (anyOrientation) {
+                cout << "Orientation: " << tpl::variantName(m.variant) << endl;
+            }
+        }
+
+        return 0;
+    }
+
+    tpl::Image haystack, needle;
+    if (!tpl::load(haystack_path, haystack) || !tpl::load(needle_path, needle)) {
+        cerr << "Couldn't load images!" << endl;
+        return 1;
+    }
+
+    tpl::Match m;
+    if (!scales.empty()) {
+        m = tpl::match(haystack, needle, scales, anyOrientation, thread::hardware_concurrency());
+    } else if (anyOrientation) {
+        vector<tpl::Image> needles;
+        tpl::variants(needle, needles);
+        m = tpl::match(haystack, needles);
+    } else {
+        m = tpl::match(haystack, needle);
+    }
+
+    cout << "Result: " << m.result << endl;
+    if (m.result) {
+        cout << "Found at [" << m.x << "," << m.y << "]" << endl;
+        if (anyOrientation) {
+            cout << "Orientation: " << tpl::variantName(m.variant) << endl;
+        }
+        if (!scales.empty()) {
+            cout << "Scale: " << m.scale << endl;
+        }
+        bool swapped = m.variant >= tpl::TRANSPOSE;
+        int cols = cvRound(needle.pixels.cols * m.scale);
+        int rows = cvRound(needle.pixels.rows * m.scale);
+        int w = swapped ? rows : cols;
+        int h = swapped ? cols : rows;
+        rectangle(haystack.pixels, Point(m.x, m.y), Point(m.x + w, m.y + h), Scalar::all(0), 2, 8, 0);
+        imshow("Result", haystack.pixels);
         waitKey(0);
     }
 
@@ -0,0 +1,78 @@
+/**
+ * @author VaL Doroshchuk <valbok@gmail.com>
+ * @created 16 Oct 2026
+ */
+
+/**
+ * Needles pasted into a haystack at known places, in every orientation, must be found exactly there:
+ * at the top left corner of the pasted pixels, with the pasted orientation and a perfect result.
+ * Places include the first and the last row and column of the haystack.
+ */
+
+#include "../common/check.h"
+#include "match.h"
+
+#include <iostream>
+#include <vector>
+
+using namespace cv;
+using namespace std;
+
+const int HAYSTACK_COLS = 120;
+const int HAYSTACK_ROWS = 90;
+
+/**
+ * Dark random haystack with the bright needle pasted at \a place. The window of the needle is the only one
+ * with its sum, so even the single orientation search, which trusts an equal sum, must find it.
+ */
+tpl::Image haystackWith(RNG& rng, const tpl::Image& needle, Point place) {
+    tpl::Image result;
+    result.pixels.create(HAYSTACK_ROWS, HAYSTACK_COLS, CV_8UC3);
+    rng.fill(result.pixels, RNG::UNIFORM, 0, 64);
+    Mat window = result.pixels(Rect(place.x, place.y, needle.pixels.cols, needle.pixels.rows));
+    needle.pixels.copyTo(window);
+    tpl::integral(result.pixels, result.sum);
+
+    return result;
+}
+
+/**
+ * Top left, somewhere inside and bottom right places of a needle of the size.
+ */
+vector<Point> placesOf(Size size) {
+    vector<Point> result;
+    result.push_back(Point(0, 0));
+    result.push_back(Point(37, 23));
+    result.push_back(Point(HAYSTACK_COLS - size.width, HAYSTACK_ROWS - size.height));
+
+    return result;
+}
+
+int main() {
+    RNG rng(0x54504c);
+    tpl::Image needle;
+    needle.pixels.create(11, 17, CV_8UC3);
+    rng.fill(needle.pixels, RNG::UNIFORM, 128, 256);
+    tpl::integral(needle.pixels, needle.sum);
+    vector<tpl::Image> needles;
+    tpl::variants(needle, needles);
+
+    for (int v = tpl::IDENTITY; v < tpl::VARIANTS_COUNT; ++v) {
+        vector<Point> places = placesOf(needles[v].pixels.size());
+        for (size_t p = 0; p < places.size(); ++p) {
+            tpl::Image haystack = haystackWith(rng, needles[v], places[p]);
+            tpl::Match m = tpl::match(haystack, needles);
+            if (!CHECK(m.x == places[p].x && m.y == places[p].y && m.variant == v && m.result == 1)) {
+                cerr << tpl::variantName(v) << " at [" << places[p].x << ", " << places[p].y << "]: found " <<
+                    tpl::variantName(m.variant) << " at [" << m.x << ", " << m.y << "], " << m.result << endl;
+            }
+
+            if (v == tpl::IDENTITY) {
+                m = tpl::match(haystack, needle);
+                CHECK(m.x == places[p].x && m.y == places[p].y && m.result == 1);
+            }
+        }
+    }
+
+    return check::report("tpltest");
+}